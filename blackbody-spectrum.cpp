@@ -2,17 +2,97 @@
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdio>
+#include <chrono>
+#include <algorithm>
+#include <immintrin.h>
+#include "photometry.h"
 
 const int WIDTH = 1400;
 const int HEIGHT = 900;
 
-float planck(float wavelength, float temp) {
-    float h = 6.626e-34f;
-    float c = 3.0e8f;
-    float k = 1.381e-23f;
-    float a = 2.0f * h * c * c / (wavelength * wavelength * wavelength * wavelength * wavelength);
-    float b = h * c / (wavelength * k * temp);
-    return a / (expf(b) - 1.0f);
+// Per-wavelength factors shared by every temperature in a batch.
+struct PlanckGrid {
+    std::vector<double> a, b;   // 2hc^2 / lambda^5 and hc / (lambda k)
+};
+
+PlanckGrid planckGrid(const double* wavelengths, int nw) {
+    PlanckGrid g;
+    g.a.resize(nw);
+    g.b.resize(nw);
+    for (int i = 0; i < nw; ++i) {
+        double l = wavelengths[i], l2 = l * l;
+        g.a[i] = RAD_C1 / (l2 * l2 * l);
+        g.b[i] = RAD_C2 / l;
+    }
+    return g;
+}
+
+void planckRowScalar(const PlanckGrid& g, double temp, double* out) {
+    double invT = 1.0 / temp;
+    for (size_t i = 0; i < g.a.size(); ++i) out[i] = g.a[i] / std::expm1(g.b[i] * invT);
+}
+
+// exp(x) - 1 for 4 doubles (x >= 0), to a few ulp. Below 0.5 a Taylor series
+// avoids the cancellation of exp(x) - 1; above it exp is reduced to
+// 2^n * exp(r) with |r| <= ln2/2. 2^n is applied as two factors so the result
+// overflows to +inf exactly where std::expm1 does, which makes B exactly 0.
+__attribute__((target("avx2,fma")))
+static __m256d expm1AVX2(__m256d x) {
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    __m256d t = _mm256_set1_pd(1.0 / 6227020800.0);   // 1/13!
+    const double inv[] = {1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0,
+                          1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0,
+                          1.0 / 6.0, 0.5, 1.0};
+    for (double c : inv) t = _mm256_fmadd_pd(t, x, _mm256_set1_pd(c));
+    __m256d small = _mm256_mul_pd(t, x);
+
+    __m256d xc = _mm256_min_pd(x, _mm256_set1_pd(746.0));
+    __m256d n = _mm256_round_pd(_mm256_mul_pd(xc, _mm256_set1_pd(1.4426950408889634)),
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(6.93147180369123816490e-01), xc);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(1.90821492927058770002e-10), r);
+    __m256d p = _mm256_set1_pd(1.0 / 479001600.0);
+    const double inv2[] = {1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0, 1.0 / 40320.0,
+                           1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 0.5, 1.0, 1.0};
+    for (double c : inv2) p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(c));
+    __m256i n1 = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+    __m256i n2 = _mm256_srli_epi64(n1, 1);
+    n1 = _mm256_sub_epi64(n1, n2);
+    const __m256i bias = _mm256_set1_epi64x(1023);
+    __m256d s1 = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(n1, bias), 52));
+    __m256d s2 = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(n2, bias), 52));
+    __m256d big = _mm256_sub_pd(_mm256_mul_pd(_mm256_mul_pd(p, s1), s2), one);
+
+    return _mm256_blendv_pd(big, small, _mm256_cmp_pd(x, _mm256_set1_pd(0.5), _CMP_LT_OQ));
+}
+
+__attribute__((target("avx2,fma")))
+void planckRowAVX2(const PlanckGrid& g, double temp, double* out) {
+    int n = (int)g.a.size(), i = 0;
+    __m256d invT = _mm256_set1_pd(1.0 / temp);
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_mul_pd(_mm256_loadu_pd(&g.b[i]), invT);
+        _mm256_storeu_pd(out + i, _mm256_div_pd(_mm256_loadu_pd(&g.a[i]), expm1AVX2(x)));
+    }
+    for (; i < n; ++i) out[i] = g.a[i] / std::expm1(g.b[i] / temp);
+}
+
+bool hasAVX2() {
+    static bool ok = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return ok;
+}
+
+// Batch API: out[t * nw + w] = B(wavelengths[w], temps[t]). `out` must hold
+// nw * nt doubles. Uses AVX2 when the CPU has it unless `simd` is false.
+void planckBatch(const double* wavelengths, int nw, const double* temps, int nt, double* out, bool simd = true) {
+    PlanckGrid g = planckGrid(wavelengths, nw);
+    bool vec = simd && hasAVX2();
+    for (int t = 0; t < nt; ++t) {
+        if (vec) planckRowAVX2(g, temps[t], out + (size_t)t * nw);
+        else planckRowScalar(g, temps[t], out + (size_t)t * nw);
+    }
 }
 
 struct SpectrumPoint {
@@ -20,53 +100,146 @@ struct SpectrumPoint {
     float intensity;
 };
 
-std::vector<SpectrumPoint> generateSpectrum(float temp, int samples = 400) {
+// The 300-1000 nm spectrum on screen. Recomputed into the same buffers only
+// when the temperature differs from the cached one.
+class SpectrumCache {
+public:
+    explicit SpectrumCache(int samples = 400) : wl(samples), row(samples), points(samples) {
+        double start = 300e-9, end = 1000e-9;
+        for (int i = 0; i < samples; ++i) {
+            wl[i] = start + (end - start) * i / (samples - 1);
+            points[i].wavelength = (float)(wl[i] * 1e9);
+        }
+        grid = planckGrid(wl.data(), samples);
+    }
+
+    const std::vector<SpectrumPoint>& get(float temp) {
+        if (temp != cachedTemp) {
+            if (hasAVX2()) planckRowAVX2(grid, temp, row.data());
+            else planckRowScalar(grid, temp, row.data());
+            maxI = 0;
+            for (size_t i = 0; i < row.size(); ++i) {
+                points[i].intensity = (float)row[i];
+                maxI = std::max(maxI, points[i].intensity);
+            }
+            cachedTemp = temp;
+        }
+        return points;
+    }
+    float maxIntensity() const { return maxI; }
+    void invalidate() { cachedTemp = -1; }
+
+private:
+    std::vector<double> wl, row;
+    PlanckGrid grid;
     std::vector<SpectrumPoint> points;
-    float start = 300e-9f;
-    float end = 1000e-9f;
-    for (int i = 0; i < samples; ++i) {
-        float wl = start + (end - start) * i / (samples - 1);
-        float intensity = planck(wl, temp);
-        points.push_back({wl * 1e9f, intensity});
+    float cachedTemp = -1;
+    float maxI = 0;
+};
+
+float peakWavelength(float temp) {
+    return 2.897e6f / temp;
+}
+
+// Headless sweep: each step moves the temperature by tempStep (like holding
+// UP/DOWN) and recomputes the spectrum, which is appended to a CSV file.
+int runHeadless(float temperature, float tempStep, int steps, const char* out) {
+    FILE* f = fopen(out, "w");
+    if (!f) {
+        fprintf(stderr, "cannot write %s\n", out);
+        return 1;
     }
-    return points;
+    fprintf(f, "step,temperature,wavelength_nm,intensity\n");
+    SpectrumCache cache;
+    double busy = 0;
+    for (int s = 0; s < steps; ++s) {
+        float temp = temperature + tempStep * s;
+        if (temp <= 0) break;
+        auto t0 = std::chrono::steady_clock::now();
+        const std::vector<SpectrumPoint>& spectrum = cache.get(temp);
+        busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        for (const auto& p : spectrum) fprintf(f, "%d,%.1f,%.3f,%.6e\n", s, temp, p.wavelength, p.intensity);
+    }
+    fclose(f);
+    printf("%d spectra, wall time per step %.4f ms, wrote %s\n", steps, steps ? busy / steps * 1e3 : 0.0, out);
+    return 0;
 }
 
-Color wavelengthToColor(float wl_nm) {
-    if (wl_nm < 380) return PURPLE;
-    if (wl_nm < 420) return VIOLET;
-    if (wl_nm < 490) return BLUE;
-    if (wl_nm < 570) return GREEN;
-    if (wl_nm < 590) return YELLOW;
-    if (wl_nm < 620) return ORANGE;
-    return RED;
+// Batch evaluation of nt temperatures (1000-50000 K) x nw wavelengths
+// (10 nm - 1 mm, log spaced), scalar vs AVX2, and the largest relative
+// difference between the two.
+int runBench(int nw, int nt) {
+    std::vector<double> wl(nw), temps(nt);
+    for (int i = 0; i < nw; ++i) wl[i] = 1e-8 * pow(1e5, i / (double)std::max(1, nw - 1));
+    for (int t = 0; t < nt; ++t) temps[t] = 1000 + 49000.0 * t / std::max(1, nt - 1);
+    std::vector<double> ref((size_t)nw * nt), vec((size_t)nw * nt);
+
+    auto time = [&](std::vector<double>& out, bool simd) {
+        auto t0 = std::chrono::steady_clock::now();
+        planckBatch(wl.data(), nw, temps.data(), nt, out.data(), simd);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    };
+    double ts = time(ref, false);
+    double tv = time(vec, true);
+    double maxErr = 0;
+    for (size_t i = 0; i < ref.size(); ++i)
+        if (ref[i] > 0) maxErr = std::max(maxErr, fabs(vec[i] - ref[i]) / ref[i]);
+        else if (vec[i] != 0) maxErr = INFINITY;
+
+    double evals = (double)nw * nt;
+    printf("%d wavelengths x %d temperatures\n", nw, nt);
+    printf("scalar  %8.2f M evals/s\n", evals / ts / 1e6);
+    printf("%-7s %8.2f M evals/s (%.1fx), max rel diff %.2e\n", hasAVX2() ? "avx2" : "scalar",
+           evals / tv / 1e6, ts / tv, maxErr);
+    return 0;
 }
 
-int main() {
+int main(int argc, char** argv) {
+    float temperature = 5772.0f;
+    bool headless = false;
+    float tempStep = 50.0f;
+    int steps = 100;
+    char out[256] = "spectra.csv";
+    bool bench = false;
+    int benchW = 400, benchT = 20000;
+    for (int i = 1; i < argc; ++i) {
+        if (sscanf(argv[i], "--wavelengths=%d", &benchW) == 1) continue;
+        if (sscanf(argv[i], "--temps=%d", &benchT) == 1) continue;
+        if (std::string(argv[i]) == "--bench") { bench = true; continue; }
+        if (sscanf(argv[i], "--temp=%f", &temperature) == 1) continue;
+        if (sscanf(argv[i], "--temp-step=%f", &tempStep) == 1) continue;
+        if (sscanf(argv[i], "--steps=%d", &steps) == 1) continue;
+        if (sscanf(argv[i], "--out=%255s", out) == 1) continue;
+        if (std::string(argv[i]) == "--headless") { headless = true; continue; }
+        fprintf(stderr, "usage: %s [--temp=K] [--headless --steps=N --temp-step=K --out=FILE] [--bench --wavelengths=N --temps=N]\n", argv[0]);
+        return 1;
+    }
+    if (temperature <= 0) {
+        fprintf(stderr, "--temp must be > 0\n");
+        return 1;
+    }
+    if (bench) return runBench(std::max(1, benchW), std::max(1, benchT));
+    if (headless) return runHeadless(temperature, tempStep, steps, out);
+
     InitWindow(WIDTH, HEIGHT, "Blackbody Spectrum Visualizer");
     SetTargetFPS(60);
 
-    float temperature = 5772.0f;
     bool showGraph = true;
 
-    std::vector<SpectrumPoint> currentSpectrum = generateSpectrum(temperature);
+    SpectrumCache spectrum;
 
     while (!WindowShouldClose()) {
         if (IsKeyDown(KEY_UP)) temperature += 50;
         if (IsKeyDown(KEY_DOWN) && temperature > 1000) temperature -= 50;
         if (IsKeyPressed(KEY_SPACE)) showGraph = !showGraph;
-        if (IsKeyPressed(KEY_R)) currentSpectrum = generateSpectrum(temperature);
+        if (IsKeyPressed(KEY_R)) spectrum.invalidate();
 
-        currentSpectrum = generateSpectrum(temperature);
+        const std::vector<SpectrumPoint>& currentSpectrum = spectrum.get(temperature);
+        float maxIntensity = spectrum.maxIntensity();
 
         BeginDrawing();
         ClearBackground(BLACK);
 
-        float maxIntensity = 0;
-        for (const auto& p : currentSpectrum) {
-            if (p.intensity > maxIntensity) maxIntensity = p.intensity;
-        }
-
         if (showGraph) {
             int graphX = 100;
             int graphY = 150;
@@ -83,20 +256,24 @@ int main() {
                 float y1 = graphY + graphH - (currentSpectrum[i-1].intensity / maxIntensity) * graphH;
                 float y2 = graphY + graphH - (currentSpectrum[i].intensity / maxIntensity) * graphH;
 
-                Color col = wavelengthToColor(currentSpectrum[i].wavelength);
+                Color col = Photometry::get().wavelengthColor(currentSpectrum[i].wavelength);
                 DrawLineEx({x1, y1}, {x2, y2}, 3.0f, col);
             }
 
-            float peakWL = 2.897e6f / temperature;
+            float peakWL = peakWavelength(temperature);
             float peakX = graphX + (peakWL - 300) / 700.0f * graphW;
             DrawLineEx({peakX, graphY}, {peakX, graphY + graphH}, 2.0f, YELLOW);
         }
 
         DrawCircle(WIDTH / 2, 100, 60, BLACK);
-        Color starColor = wavelengthToColor(2.897e6f / temperature);
+        Color starColor = blackbodyColor(temperature);
         DrawCircle(WIDTH / 2, 100, 58, starColor);
 
         DrawText(TextFormat("Temperature: %.0f K", temperature), 20, 20, 24, WHITE);
+        const Photometry& phot = Photometry::get();
+        DrawText(TextFormat("B-V %.2f  BP-RP %.2f  BC_V %.2f", phot.colorIndex(BandB, BandV, temperature),
+                            phot.colorIndex(BandBP, BandRP, temperature), phot.bc(BandV, temperature)),
+                 WIDTH - 420, 20, 20, WHITE);
         DrawText("UP / DOWN - Change temperature", 20, 60, 20, LIME);
         DrawText("SPACE - Toggle spectrum graph", 20, 90, 20, LIME);
         DrawText("R - Refresh spectrum", 20, 120, 20, LIME);
@@ -1,41 +1,413 @@
 #include <iostream>
 #include <cmath>
 #include <cstdio>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 using namespace std;
 const double c = 299792.458;
-const double H0 = 70.0;
-const double Om = 0.3;
-const double Ol = 0.7;
+const double HUBBLE_TIME_GYR = 977.7922216807891;   // 1/H0 in Gyr for H0 in km/s/Mpc
 
-double E(double z) {
-    return sqrt(Om * pow(1 + z, 3) + Ol);
+// Om, Ol and Ok = 1 - Om - Ol; no radiation term.
+double E(double z, double om, double ol) {
+    double a = 1 + z;
+    return sqrt(om * a * a * a + (1 - om - ol) * a * a + ol);
 }
-double trapz(double z, int steps = 1000) {
+double trapz(double z, double om, double ol, int steps = 1000) {
     double sum = 0;
     double dz = z / steps;
     for (int i = 0; i < steps; i++) {
         double z1 = i * dz;
         double z2 = (i + 1) * dz;
-        sum += 0.5 * (1.0/E(z1) + 1.0/E(z2)) * dz;
+        sum += 0.5 * (1.0/E(z1, om, ol) + 1.0/E(z2, om, ol)) * dz;
     }
     return sum;
 }
-void calc(double z) {
-    double integral = trapz(z);
-    double dh = c / H0;
-    double dc = dh * integral;
-    double dl = dc * (1 + z);
-    double da = dc / (1 + z);
-    
+
+// 8-point Gauss-Legendre on [a, b].
+template <class F>
+double gauss8(F f, double a, double b) {
+    static const double x[4] = {0.1834346424956498, 0.5255324099163290, 0.7966664774136267, 0.9602898564975363};
+    static const double w[4] = {0.3626837833783620, 0.3137066458778873, 0.2223810344533745, 0.1012285362903763};
+    double m = 0.5 * (a + b), h = 0.5 * (b - a), s = 0;
+    for (int k = 0; k < 4; k++) s += w[k] * (f(m - h * x[k]) + f(m + h * x[k]));
+    return s * h;
+}
+
+// Gauss-Legendre over [a, b] split into panels no wider than `width`.
+template <class F>
+double gaussPanels(F f, double a, double b, double width) {
+    int n = max(1, (int)ceil(fabs(b - a) / width));
+    double h = (b - a) / n, s = 0;
+    for (int i = 0; i < n; i++) s += gauss8(f, a + i * h, a + (i + 1) * h);
+    return s;
+}
+
+// dchi/du with u = ln(1+z).
+double chiIntegrand(double u, double om, double ok, double ol) {
+    double a = exp(u);
+    return a / sqrt(om * a * a * a + ok * a * a + ol);
+}
+
+// Cosmic time integrand H0 dt in s = sqrt(scale factor): dt = da / (a E(a))
+// becomes 2 s^2 / sqrt(om + ok s^2 + ol s^6) ds, smooth all the way to s = 0.
+double timeIntegrand(double s, double om, double ok, double ol) {
+    double s2 = s * s;
+    return 2 * s2 / sqrt(om + ok * s2 + ol * s2 * s2 * s2);
+}
+
+// Line-of-sight comoving distance integral chi(z) = int_0^z dz'/E(z'),
+// tabulated once in u = ln(1+z) and read back with cubic Hermite
+// interpolation using the exact derivative dchi/du = (1+z)/E(z). The table
+// is refined until interval midpoints agree with direct integration to `tol`
+// (relative), so every query in [0, zmax] carries that accuracy; queries
+// outside that range return NaN rather than extrapolating.
+struct Cosmology {
+    double h0, om, ol, ok;
+    double zmax;
+    double dh;                          // Hubble distance c/H0, Mpc
+    double h, invH;                     // node spacing in u
+    vector<double> chi, dchi;           // chi and dchi/du at the nodes
+    double maxErr = 0;                  // measured worst relative error
+
+    Cosmology(double H0_, double Om_, double Ol_, double zmax_ = 1200, double tol = 1e-10)
+        : h0(H0_), om(Om_), ol(Ol_), ok(1 - Om_ - Ol_), zmax(zmax_), dh(c / H0_) {
+        for (int n = 256;; n *= 2) {
+            build(n);
+            maxErr = check();
+            if (maxErr <= tol || std::isnan(maxErr) || n >= (1 << 22)) break;
+        }
+    }
+
+    double e(double z) const {
+        double a = 1 + z;
+        return sqrt(om * a * a * a + ok * a * a + ol);
+    }
+    double du(double u) const { return chiIntegrand(u, om, ok, ol); }
+
+    void build(int n) {
+        double umax = log1p(zmax);
+        h = umax / n;
+        invH = n / umax;
+        chi.assign(n + 1, 0);
+        dchi.assign(n + 1, 0);
+        dchi[0] = du(0);
+        for (int i = 1; i <= n; i++) {
+            chi[i] = chi[i - 1] + gauss8([this](double u) { return du(u); }, (i - 1) * h, i * h);
+            dchi[i] = du(i * h);
+        }
+    }
+
+    double check() const {
+        double worst = 0;
+        for (size_t i = 0; i + 1 < chi.size(); i++) {
+            double um = (i + 0.5) * h;
+            double exact = chi[i] + gauss8([this](double u) { return du(u); }, i * h, um);
+            double err = fabs(interp(um) - exact) / exact;
+            worst = max(worst, err);
+        }
+        return worst;
+    }
+
+    double interp(double u) const {
+        double x = u * invH;
+        size_t i = min((size_t)x, chi.size() - 2);
+        double t = x - i, t2 = t * t, t3 = t2 * t;
+        return (2 * t3 - 3 * t2 + 1) * chi[i] + (t3 - 2 * t2 + t) * h * dchi[i]
+             + (-2 * t3 + 3 * t2) * chi[i + 1] + (t3 - t2) * h * dchi[i + 1];
+    }
+
+    // Dimensionless line-of-sight and transverse comoving distances.
+    double chiOf(double z) const { return z >= 0 && z <= zmax ? interp(log1p(z)) : NAN; }
+    double transverse(double x) const {
+        if (ok > 1e-12) return sinh(sqrt(ok) * x) / sqrt(ok);
+        if (ok < -1e-12) return sin(sqrt(-ok) * x) / sqrt(-ok);
+        return x;
+    }
+
+    double comoving(double z) const { return dh * chiOf(z); }
+    double luminosity(double z) const { return dh * transverse(chiOf(z)) * (1 + z); }
+    double angular(double z) const { return dh * transverse(chiOf(z)) / (1 + z); }
+    double modulus(double z) const { return 5 * log10(luminosity(z)) + 25; }
+
+    double lookbackGyr(double z) const {
+        double s = 1 / sqrt(1 + z);
+        return HUBBLE_TIME_GYR / h0 * gaussPanels([this](double x) { return timeIntegrand(x, om, ok, ol); }, s, 1, 0.02);
+    }
+    double ageGyr() const { return lookbackGyr(INFINITY); }
+
+    // Batch queries in Mpc (and mag for mu); pass nullptr for outputs not needed.
+    void distances(const double* z, size_t n, double* dc, double* dl, double* da, double* mu) const {
+        for (size_t k = 0; k < n; k++) {
+            double x = chiOf(z[k]), dm = dh * transverse(x), a = 1 + z[k];
+            if (dc) dc[k] = dh * x;
+            if (dl) dl[k] = dm * a;
+            if (da) da[k] = dm / a;
+            if (mu) mu[k] = 5 * log10(dm * a) + 25;
+        }
+    }
+};
+
+// One model of a parameter sweep: age plus, at every redshift in `zs`
+// (ascending), lookback time, D_C, D_L, D_A and mu. Integrates straight
+// through the sorted redshifts instead of building a Cosmology table, which
+// would cost far more than the handful of values needed per model. Models
+// with E^2 <= 0 somewhere (no big bang) come out as NaN.
+const int SweepFixed = 5;   // H0, Om, Ol, Ok, age
+const int SweepPerZ = 5;    // lookback, Dc, Dl, Da, mu
+
+void evalModel(double h0, double om, double ol, const vector<double>& zs, double* out) {
+    double ok = 1 - om - ol;
+    double dh = c / h0, th = HUBBLE_TIME_GYR / h0;
+    auto fc = [&](double u) { return chiIntegrand(u, om, ok, ol); };
+    auto ft = [&](double s) { return timeIntegrand(s, om, ok, ol); };
+    out[0] = h0;
+    out[1] = om;
+    out[2] = ol;
+    out[3] = ok;
+    double chi = 0, u = 0, look = 0, s = 1;
+    for (size_t k = 0; k < zs.size(); k++) {
+        double u1 = log1p(zs[k]), s1 = 1 / sqrt(1 + zs[k]);
+        chi += gaussPanels(fc, u, u1, 0.05);
+        look += gaussPanels(ft, s1, s, 0.02);
+        u = u1;
+        s = s1;
+        double dm = chi;
+        if (ok > 1e-12) dm = sinh(sqrt(ok) * chi) / sqrt(ok);
+        else if (ok < -1e-12) dm = sin(sqrt(-ok) * chi) / sqrt(-ok);
+        dm *= dh;
+        double* r = out + SweepFixed + SweepPerZ * k;
+        r[0] = th * look;
+        r[1] = dh * chi;
+        r[2] = dm * (1 + zs[k]);
+        r[3] = dm / (1 + zs[k]);
+        r[4] = 5 * log10(dm * (1 + zs[k])) + 25;
+    }
+    out[4] = th * (look + gaussPanels(ft, 0, s, 0.02));
+    if (std::isnan(out[4])) fill(out + 4, out + SweepFixed + SweepPerZ * zs.size(), NAN);
+}
+
+struct Axis {
+    double lo = 0, hi = 0;
+    int n = 1;
+    double at(int i) const { return n == 1 ? lo : lo + (hi - lo) * i / (n - 1); }
+};
+
+// "lo:hi:n" or a single value.
+Axis parseAxis(const string& s) {
+    Axis a;
+    if (sscanf(s.c_str(), "%lf:%lf:%d", &a.lo, &a.hi, &a.n) == 3 && a.n >= 1) return a;
+    a.lo = a.hi = stod(s);
+    a.n = 1;
+    return a;
+}
+
+// Binary sweep file: this header, then the redshift list (nz doubles), then
+// nH0 * nOm * nThird records of SweepFixed + SweepPerZ * nz doubles, H0
+// outermost. The third axis is Ol, or Ok when okAxis is set (Ol = 1-Om-Ok).
+struct SweepHeader {
+    char magic[8];              // "COSMOSWP"
+    uint32_t version;           // 1
+    uint32_t okAxis;
+    uint32_t nH0, nOm, nThird, nz;
+    double h0[2], om[2], third[2];
+    uint32_t recordDoubles;
+    uint32_t pad;
+};
+
+// Evaluates the grid on `threads` threads. Workers claim chunks of models
+// from an atomic counter and append them to the file strictly in chunk
+// order, so memory stays at one chunk per thread whatever the grid size.
+// The file is written to PATH.tmp and renamed once every write succeeded.
+int runSweep(Axis h0, Axis om, Axis third, bool okAxis, vector<double> zs, int threads, const string& path) {
+    sort(zs.begin(), zs.end());
+    string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) {
+        fprintf(stderr, "cannot write %s\n", tmp.c_str());
+        return 1;
+    }
+    SweepHeader hd = {};
+    memcpy(hd.magic, "COSMOSWP", 8);
+    hd.version = 1;
+    hd.okAxis = okAxis;
+    hd.nH0 = h0.n;
+    hd.nOm = om.n;
+    hd.nThird = third.n;
+    hd.nz = zs.size();
+    hd.h0[0] = h0.lo; hd.h0[1] = h0.hi;
+    hd.om[0] = om.lo; hd.om[1] = om.hi;
+    hd.third[0] = third.lo; hd.third[1] = third.hi;
+    hd.recordDoubles = SweepFixed + SweepPerZ * zs.size();
+    bool ok = fwrite(&hd, sizeof hd, 1, f) == 1 && fwrite(zs.data(), sizeof(double), zs.size(), f) == zs.size();
+
+    const size_t total = (size_t)h0.n * om.n * third.n, chunk = 1024, rec = hd.recordDoubles;
+    const size_t chunks = (total + chunk - 1) / chunk;
+    atomic<size_t> next{0};
+    size_t written = 0;
+    mutex m;
+    condition_variable cv;
+    size_t invalid = 0;
+
+    auto work = [&] {
+        vector<double> buf(chunk * rec);
+        size_t bad = 0;
+        for (size_t ci; (ci = next++) < chunks;) {
+            size_t p0 = ci * chunk, p1 = min(total, p0 + chunk);
+            for (size_t p = p0; p < p1; p++) {
+                size_t k = p % third.n, j = p / third.n % om.n, i = p / third.n / om.n;
+                double o = om.at(j), t = third.at(k);
+                double* r = &buf[(p - p0) * rec];
+                evalModel(h0.at(i), o, okAxis ? 1 - o - t : t, zs, r);
+                if (std::isnan(r[4])) bad++;
+            }
+            unique_lock<mutex> lk(m);
+            cv.wait(lk, [&] { return written == ci; });
+            ok = ok && fwrite(buf.data(), sizeof(double), (p1 - p0) * rec, f) == (p1 - p0) * rec;
+            written++;
+            cv.notify_all();
+        }
+        lock_guard<mutex> lk(m);
+        invalid += bad;
+    };
+
+    auto t0 = chrono::steady_clock::now();
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++) pool.emplace_back(work);
+    for (auto& t : pool) t.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        fprintf(stderr, "cannot write %s\n", path.c_str());
+        remove(tmp.c_str());
+        return 1;
+    }
+
+    printf("%zu models x %zu redshifts on %d threads: %.3f s, %.3e models/s (%.3e per thread)\n",
+           total, zs.size(), threads, secs, total / secs, total / secs / threads);
+    printf("%zu models without a big bang (NaN); wrote %s\n", invalid, path.c_str());
+    return 0;
+}
+
+void calc(const Cosmology& cosmo, double z) {
+    double dc = cosmo.comoving(z);
+    double dl = cosmo.luminosity(z);
+    double da = cosmo.angular(z);
+
     printf("z: %.2f | Dc: %.1f Mpc | Dl: %.1f Mpc | Da: %.1f Mpc\n", z, dc, dl, da);
 }
-int main() {
-    printf("Cosmology Calculator (H0=70, Om=0.3, Ol=0.7)\n");
-    for (double z : {0.1, 0.5, 1.0, 2.0, 5.0, 1100.0}) {
-        calc(z);
+
+// Random redshifts in [0, 5]: per-call trapz() against the table.
+void bench(const Cosmology& cosmo, size_t n) {
+    mt19937_64 rng(42);
+    uniform_real_distribution<double> uz(0, 5);
+    vector<double> z(n), dc(n), dl(n), da(n), mu(n);
+    for (auto& v : z) v = uz(rng);
+
+    size_t nSlow = min(n, (size_t)20000);
+    auto t0 = chrono::steady_clock::now();
+    volatile double sink = 0;
+    for (size_t k = 0; k < nSlow; k++) sink += cosmo.dh * trapz(z[k], cosmo.om, cosmo.ol);
+    double slow = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    t0 = chrono::steady_clock::now();
+    cosmo.distances(z.data(), n, dc.data(), dl.data(), da.data(), mu.data());
+    double fast = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    double worst = 0;
+    for (size_t k = 0; k < nSlow; k++) {
+        double ref = cosmo.dh * gauss8([&](double u) { return cosmo.du(u); }, 0, log1p(z[k]) / 2)
+                   + cosmo.dh * gauss8([&](double u) { return cosmo.du(u); }, log1p(z[k]) / 2, log1p(z[k]));
+        if (ref > 0) worst = max(worst, fabs(dc[k] - ref) / ref);
+    }
+    printf("table: %zu nodes, max rel err %.1e (checked at interval midpoints)\n", cosmo.chi.size(), cosmo.maxErr);
+    printf("trapz per call:   %10.3e queries/s\n", nSlow / slow);
+    printf("table Dc/Dl/Da/mu: %10.3e queries/s (%.0fx)\n", n / fast, (n / fast) / (nSlow / slow));
+    printf("max |Dc - 16-pt Gauss| / Dc over %zu z: %.1e\n", nSlow, worst);
+}
+
+struct Options {
+    double h0 = 70.0, om = 0.3, ol = 0.7;
+    size_t bench = 0;
+    bool sweep = false;
+    string gridH0 = "70", gridOm = "0.3", gridOl = "0.7", gridOk;
+    vector<double> zs = {0.1, 0.5, 1.0, 2.0, 5.0, 1100.0};
+    int threads = max(1u, thread::hardware_concurrency());
+    string out = "sweep.bin";
+};
+
+vector<double> parseList(const string& s) {
+    vector<double> v;
+    size_t p = 0;
+    while (p < s.size()) {
+        size_t q = s.find(',', p);
+        if (q == string::npos) q = s.size();
+        v.push_back(stod(s.substr(p, q - p)));
+        p = q + 1;
+    }
+    return v;
+}
+
+Options parseArgs(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        size_t eq = a.find('=');
+        string key = a.substr(0, eq), val = eq == string::npos ? "" : a.substr(eq + 1);
+        if (key == "--H0") o.h0 = stod(o.gridH0 = val);
+        else if (key == "--Om") o.om = stod(o.gridOm = val);
+        else if (key == "--Ol") o.ol = stod(o.gridOl = val);
+        else if (key == "--Ok") o.gridOk = val;
+        else if (key == "--z") o.zs = parseList(val);
+        else if (key == "--bench") o.bench = stoul(val);
+        else if (key == "--sweep") o.sweep = true;
+        else if (key == "--threads") o.threads = max(1, stoi(val));
+        else if (key == "--out") o.out = val;
+        else {
+            fprintf(stderr, "unknown option %s\n"
+                    "usage: %s [--H0=70] [--Om=0.3] [--Ol=0.7] [--z=0.1,0.5,...] [--bench=N]\n"
+                    "          --sweep --H0=lo:hi:n --Om=lo:hi:n (--Ol=lo:hi:n | --Ok=lo:hi:n)\n"
+                    "                  [--z=...] [--threads=T] [--out=sweep.bin]\n", a.c_str(), argv[0]);
+            exit(1);
+        }
+    }
+    if (!o.gridOk.empty()) o.ol = 1 - o.om - stod(o.gridOk);
+    for (double z : o.zs)
+        if (!(z >= 0) || std::isinf(z)) {
+            fprintf(stderr, "--z values must be finite and >= 0 (got %g)\n", z);
+            exit(1);
+        }
+    return o;
+}
+
+int main(int argc, char** argv) {
+    Options o = parseArgs(argc, argv);
+    if (o.sweep)
+        return runSweep(parseAxis(o.gridH0), parseAxis(o.gridOm), parseAxis(o.gridOk.empty() ? o.gridOl : o.gridOk),
+                        !o.gridOk.empty(), o.zs, o.threads, o.out);
+
+    // The default table reaches z = 1200; deeper queries extend it.
+    double zmax = 1200;
+    for (double z : o.zs) zmax = max(zmax, z);
+    Cosmology cosmo(o.h0, o.om, o.ol, zmax);
+    if (o.bench) {
+        bench(cosmo, o.bench);
+        return 0;
+    }
+
+    printf("Cosmology Calculator (H0=%g, Om=%g, Ol=%g, Ok=%g)\n", cosmo.h0, cosmo.om, cosmo.ol, cosmo.ok);
+    for (double z : o.zs) {
+        calc(cosmo, z);
     }
-    trapz(10000); 
-    double age_approx = 13.8; 
-    printf("Approximate Age of Universe: %.1f Gyr\n", age_approx);
+    printf("Age of Universe: %.2f Gyr\n", cosmo.ageGyr());
     return 0;
 }
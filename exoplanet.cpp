@@ -2,6 +2,15 @@
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdio>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <charconv>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 const int SCREEN_W = 1400;
 const int SCREEN_H = 900;
@@ -10,28 +19,506 @@ float depth(float pr, float sr) {
     return (pr*pr)/(sr*sr);
 }
 
-std::vector<float> make_curve(float per, float dur, float dep, int pts=1200) {
-    std::vector<float> lc(pts);
-    float hd = dur/2;
+// Transit of a dark planet over a limb-darkened star on a circular orbit.
+// rp and a in stellar radii, inc in degrees, period and t0 (mid-transit) in
+// days; quadratic limb darkening I(mu) = 1 - u1 (1-mu) - u2 (1-mu)^2.
+struct transit_params {
+    double rp, a, inc, period, t0, u1, u2;
+    bool operator==(const transit_params& o) const { return memcmp(this,&o,sizeof o)==0; }
+};
 
-    for(int i=0;i<pts;i++) {
-        float t = (float)i/pts*per - per/2;
-        if(fabsf(t)<hd) lc[i]=1-dep;
-        else lc[i]=1;
+// Area shared by a disc of radius r at the origin and one of radius p at
+// distance z (Mandel & Agol's lambda^e times pi r^2).
+double overlap_area(double r, double p, double z) {
+    if(z >= r+p) return 0;
+    if(z <= fabs(r-p)) { double m = fmin(r,p); return M_PI*m*m; }
+    double k0 = acos(fmax(-1.0,fmin(1.0,(r*r+z*z-p*p)/(2*r*z))));
+    double k1 = acos(fmax(-1.0,fmin(1.0,(p*p+z*z-r*r)/(2*p*z))));
+    return r*r*k0 + p*p*k1 - 0.5*sqrt(fmax(0.0,(-z+r+p)*(z+r-p)*(z-r+p)*(z+r+p)));
+}
+
+// Gauss-Legendre nodes and weights on [0,1].
+struct gauss_rule {
+    std::vector<double> x, w;
+    explicit gauss_rule(int n) : x(n), w(n) {
+        for(int i=0;i<n;i++) {
+            double t = cos(M_PI*(i+0.75)/(n+0.5)), dp = 1;
+            for(int it=0;it<100;it++) {
+                double p0 = 1, p1 = t;
+                for(int k=2;k<=n;k++) { double p2 = ((2*k-1)*t*p1-(k-1)*p0)/k; p0 = p1; p1 = p2; }
+                dp = n*(t*p1-p0)/(t*t-1);
+                double dt = p1/dp;
+                t -= dt;
+                if(fabs(dt) < 1e-15) break;
+            }
+            x[i] = 0.5*(1-t);
+            w[i] = 1/((1-t*t)*dp*dp);
+        }
+    }
+};
+
+// Fraction of the stellar flux hidden by a planet of radius p at separation
+// z. Integrating by parts in mu = sqrt(1-r^2), the blocked flux is
+//   (1-u1-u2) A(1) + int_0^1 A(r(mu)) (u1 + 2 u2 (1-mu)) dmu
+// over the exact overlap area A(r), with a smooth weight. Gauss-Legendre
+// panels are split at the contact radii |z-p| and z+p where A has kinks;
+// ingress and egress come out of the geometry. u1 = u2 = 0 is the exact
+// uniform-disc result.
+double occulted(double z, double p, double u1, double u2, const gauss_rule& g) {
+    if(z >= 1+p) return 0;
+    double a1 = overlap_area(1,p,z);
+    double blocked = (1-u1-u2)*a1;
+    if(u1 != 0 || u2 != 0) {
+        // z+p > |z-p|, so its mu is the smaller one
+        double edges[4] = {0};
+        int ne = 1;
+        for(double r : {z+p, fabs(z-p)})
+            if(r > 0 && r < 1) edges[ne++] = sqrt(1-r*r);
+        edges[ne++] = 1;
+        for(int e=0;e+1<ne;e++) {
+            double lo = edges[e], hi = edges[e+1];
+            if(hi <= lo) continue;
+            for(size_t k=0;k<g.x.size();k++) {
+                double mu = lo + (hi-lo)*g.x[k];
+                blocked += (hi-lo)*g.w[k]*overlap_area(sqrt(fmax(0.0,1-mu*mu)),p,z)*(u1+2*u2*(1-mu));
+            }
+        }
+    }
+    return blocked/(M_PI*(1-u1/3-u2/6));
+}
+
+// Relative flux at n times; out-of-transit points cost one sincos.
+void transit_flux(const transit_params& tp, const double* t, double* flux, size_t n) {
+    static const gauss_rule g(12);
+    double ci = cos(tp.inc*M_PI/180), w = 2*M_PI/tp.period;
+    for(size_t k=0;k<n;k++) {
+        double ph = w*(t[k]-tp.t0), s = sin(ph), c = cos(ph);
+        double z = tp.a*sqrt(s*s + ci*ci*c*c);
+        flux[k] = c > 0 && z < 1+tp.rp ? 1 - occulted(z,tp.rp,tp.u1,tp.u2,g) : 1;
+    }
+}
+
+// Model light curve on a fixed time grid. The flux buffer is reused and only
+// recomputed when the parameters change.
+struct light_curve {
+    std::vector<double> t, flux;
+    transit_params params = {};
+    double fmin = 1;
+    bool valid = false;
+
+    bool update(const transit_params& p) {
+        if(valid && p == params) return false;
+        params = p;
+        valid = true;
+        flux.resize(t.size());
+        transit_flux(p,t.data(),flux.data(),t.size());
+        fmin = t.empty() ? 1 : *std::min_element(flux.begin(),flux.end());
+        return true;
     }
+};
+
+// One period sampled at pts points, mid-transit in the middle.
+light_curve phase_grid(double period, int pts=1200) {
+    light_curve lc;
+    lc.t.resize(pts);
+    for(int i=0;i<pts;i++) lc.t[i] = ((double)i/pts - 0.5)*period;
     return lc;
 }
 
-int main() {
-    InitWindow(SCREEN_W,SCREEN_H,"Exoplanet Transit Tool");
-    SetTargetFPS(60);
+// Total duration (first to fourth contact), days; 0 if the planet misses.
+double transit_duration(const transit_params& tp) {
+    double si = sin(tp.inc*M_PI/180), b = tp.a*cos(tp.inc*M_PI/180);
+    double k = (1+tp.rp)*(1+tp.rp) - b*b;
+    if(k <= 0) return 0;
+    return tp.period/M_PI*asin(fmin(1.0,sqrt(k)/(tp.a*si)));
+}
+
+Vector2 planet_pos(Vector2 cen, float a, float inc, float ang) {
+    return {cen.x + a*cosf(ang), cen.y + a*sinf(inc*DEG2RAD)*sinf(ang)};
+}
+
+float orbit_phase(float ang) {
+    return fmodf(ang/(2*PI)+0.5f,1);
+}
+
+transit_params params_of(float planet_r, float star_r, float a, float period, float inc, float u1, float u2) {
+    return {planet_r/star_r, a/star_r, inc, period, 0, u1, u2};
+}
+
+// Same per-frame work as the window loop, without drawing: advance the orbit,
+// refresh the curve (a no-op unless parameters changed), and log the planet
+// and the flux at its phase each step.
+int run_headless(float planet_r, float star_r, float a, float period, float inc, float u1, float u2,
+                 int steps, float dt, const char* out) {
+    FILE* f = fopen(out,"w");
+    if(!f) { fprintf(stderr,"cannot write %s\n",out); return 1; }
+    fprintf(f,"step,t,phase,x,y,flux\n");
+
+    Vector2 cen = {SCREEN_W/2.0f, SCREEN_H/2.0f + 100};
+    float ang = 0;
+    double busy = 0;
+    light_curve curve = phase_grid(period);
+    for(int s=1;s<=steps;s++) {
+        auto t0 = std::chrono::steady_clock::now();
+        ang += dt/period * 2*PI;
+        curve.update(params_of(planet_r,star_r,a,period,inc,u1,u2));
+        Vector2 ppos = planet_pos(cen,a,inc,ang);
+        float phase = orbit_phase(ang);
+        double flux = curve.flux[(size_t)(phase*curve.flux.size()) % curve.flux.size()];
+        busy += std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+        fprintf(f,"%d,%.6f,%.6f,%.3f,%.3f,%.8f\n",s,s*dt,phase,ppos.x,ppos.y,flux);
+    }
+    fclose(f);
+    printf("%d steps, wall time per step %.4f ms, wrote %s\n",steps,steps ? busy/steps*1e3 : 0.0,out);
+    return 0;
+}
+
+// Model evaluations as a fitter makes them: n cadences over ten periods, and
+// the parameters nudged before every call so nothing is cached. Accuracy is
+// checked against a 64-node quadrature.
+int run_bench(size_t n, float u1, float u2) {
+    transit_params tp = {0.1, 8.0, 89.0, 3.0, 0.7, u1, u2};
+    std::vector<double> t(n), flux(n);
+    for(size_t k=0;k<n;k++) t[k] = 30.0*k/n;
+    int calls = 0;
+    size_t in_transit = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    double secs = 0;
+    while(secs < 1) {
+        tp.rp = 0.1 + 1e-6*(calls%7);
+        transit_flux(tp,t.data(),flux.data(),n);
+        calls++;
+        secs = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+    }
+    for(double f : flux) in_transit += f < 1;
+    static const gauss_rule ref(64), g(12);
+    double worst = 0;
+    for(double p : {0.01, 0.1, 0.3})
+        for(int i=0;i<=2000;i++) {
+            double z = (1+p)*i/2000.0;
+            worst = fmax(worst,fabs(occulted(z,p,u1,u2,g)-occulted(z,p,u1,u2,ref)));
+        }
+    printf("%zu cadences (%zu in transit) x %d calls: %.2f M points/s, %.2f M in-transit points/s\n",
+           n,in_transit,calls,n*(double)calls/secs/1e6,in_transit*(double)calls/secs/1e6);
+    printf("max |flux error| vs 64-node quadrature (rp 0.01-0.3, u1 %.2f u2 %.2f): %.1e\n",u1,u2,worst);
+    return 0;
+}
+
+// Synthetic photometry for testing the search: n cadences every `cadence`
+// minutes, the transit model plus white noise of `noise` ppm.
+int run_simulate(const transit_params& tp, long n, double cadence, double noise, unsigned seed, const char* out) {
+    std::vector<double> t(n), flux(n);
+    for(long k=0;k<n;k++) t[k] = k*cadence/1440.0;
+    transit_flux(tp,t.data(),flux.data(),n);
+    std::mt19937_64 rng(seed);
+    std::normal_distribution<double> gauss(0,noise*1e-6);
+    FILE* f = fopen(out,"w");
+    if(!f) { fprintf(stderr,"cannot write %s\n",out); return 1; }
+    fprintf(f,"# time_d flux\n");
+    for(long k=0;k<n;k++) fprintf(f,"%.6f %.7f\n",t[k],flux[k]+gauss(rng));
+    fclose(f);
+    printf("wrote %ld cadences over %.1f d to %s: P %.5f d, t0 %.5f d, depth %.6f, duration %.2f h\n",
+           n,t.empty() ? 0 : t.back(),out,tp.period,tp.t0,1-*std::min_element(flux.begin(),flux.end()),
+           transit_duration(tp)*24);
+    return 0;
+}
+
+// Photometry as read from disk: time (days), flux and weight 1/sigma^2.
+struct time_series {
+    std::vector<double> t, y, w;
+};
 
+// Whitespace or comma separated columns: time, flux and an optional error.
+// Lines that do not start with two numbers (headers, comments) are skipped.
+bool load_time_series(const char* path, time_series& ts) {
+    FILE* f = fopen(path,"rb");
+    if(!f) return false;
+    std::string buf;
+    char chunk[1<<16];
+    size_t got;
+    while((got = fread(chunk,1,sizeof chunk,f)) > 0) buf.append(chunk,got);
+    fclose(f);
+    const char* p = buf.data();
+    const char* end = p + buf.size();
+    while(p < end) {
+        const char* eol = (const char*)memchr(p,'\n',end-p);
+        if(!eol) eol = end;
+        double v[3];
+        int nv = 0;
+        const char* q = p;
+        while(nv < 3 && q < eol) {
+            while(q < eol && (*q==' ' || *q=='\t' || *q==',' || *q=='\r')) q++;
+            auto r = std::from_chars(q,eol,v[nv]);
+            if(r.ec != std::errc()) break;
+            q = r.ptr;
+            nv++;
+        }
+        if(nv >= 2 && std::isfinite(v[0]) && std::isfinite(v[1])) {
+            ts.t.push_back(v[0]);
+            ts.y.push_back(v[1]);
+            ts.w.push_back(nv == 3 && v[2] > 0 ? 1/(v[2]*v[2]) : 1);
+        }
+        p = eol + 1;
+    }
+    return !ts.t.empty();
+}
+
+struct bls_config {
+    double pmin = 0.5, pmax = 0;            // days; pmax 0 = a third of the baseline
+    std::vector<double> durations = {1,2,3,4,6,8,12};   // hours
+    double oversample = 2;                  // frequency steps per shortest duration
+    int bins_per_duration = 4;              // phase bins across the shortest duration
+    int threads = 0;
+};
+
+// Best box at one trial period.
+struct bls_peak {
+    double period, power, depth, duration, epoch;
+};
+
+// Each thread owns a contiguous slice of the period grid and takes chunks off
+// its front, so neighbouring trial periods stay on one core. A thread whose
+// slice is empty steals the back half of the fullest remaining slice.
+struct work_slice {
+    std::mutex m;
+    size_t lo = 0, hi = 0;
+};
+
+bool next_chunk(std::vector<work_slice>& q, int self, size_t chunk, size_t& lo, size_t& hi) {
+    {
+        std::lock_guard<std::mutex> g(q[self].m);
+        if(q[self].lo < q[self].hi) {
+            lo = q[self].lo;
+            hi = std::min(lo+chunk,q[self].hi);
+            q[self].lo = hi;
+            return true;
+        }
+    }
+    for(;;) {
+        int victim = -1;
+        size_t most = 0;
+        for(int v=0;v<(int)q.size();v++) {
+            if(v == self) continue;
+            std::lock_guard<std::mutex> g(q[v].m);
+            if(q[v].hi - q[v].lo > most) { most = q[v].hi - q[v].lo; victim = v; }
+        }
+        if(victim < 0) return false;
+        size_t slo, shi;
+        {
+            std::lock_guard<std::mutex> g(q[victim].m);
+            size_t left = q[victim].hi - q[victim].lo;
+            if(left == 0) continue;
+            shi = q[victim].hi;
+            slo = left <= chunk ? q[victim].lo : q[victim].hi - left/2;
+            q[victim].hi = slo;
+        }
+        lo = slo;
+        hi = std::min(slo+chunk,shi);
+        std::lock_guard<std::mutex> g(q[self].m);
+        q[self].lo = hi;
+        q[self].hi = shi;
+        return true;
+    }
+}
+
+// Box Least Squares (Kovacs, Zucker & Mazeh 2002). The light curve is first
+// binned onto a uniform time grid a quarter of the shortest duration wide,
+// so each trial period folds bins, not cadences. Folded bins are turned into
+// wrapped cumulative sums of weight and weighted flux; every (start,
+// duration) box is then two subtractions. With weights normalised to 1 and
+// the mean removed, a box holding weight r and flux sum s has
+// power s^2 / (r (1-r)) and depth -s / (r (1-r)).
+// The frequency grid is geometric: from one trial to the next the phase of
+// the last cadence moves by 1/oversample of the shortest duration.
+std::vector<bls_peak> bls_search(const time_series& ts, const bls_config& cfg, double& t_ref, double& baseline) {
+    double tmin = *std::min_element(ts.t.begin(),ts.t.end());
+    double tmax = *std::max_element(ts.t.begin(),ts.t.end());
+    double span = fmax(tmax-tmin,1e-9);
+    t_ref = tmin;
+    baseline = tmax-tmin;
+    double dmin = *std::min_element(cfg.durations.begin(),cfg.durations.end())/24;
+    double dmax = *std::max_element(cfg.durations.begin(),cfg.durations.end())/24;
+    double width = dmin/cfg.bins_per_duration;
+
+    // Time bins: centre, weight, weighted flux (mean removed, weights sum to 1).
+    std::vector<double> bt, bw, by;
+    {
+        size_t nb = (size_t)(span/width) + 1;
+        std::vector<double> sw(nb,0), swy(nb,0);
+        double wsum = 0, wysum = 0;
+        for(size_t k=0;k<ts.t.size();k++) { wsum += ts.w[k]; wysum += ts.w[k]*ts.y[k]; }
+        double mean = wysum/wsum;
+        for(size_t k=0;k<ts.t.size();k++) {
+            size_t b = std::min(nb-1,(size_t)((ts.t[k]-tmin)/width));
+            sw[b] += ts.w[k]/wsum;
+            swy[b] += ts.w[k]/wsum*(ts.y[k]-mean);
+        }
+        for(size_t b=0;b<nb;b++)
+            if(sw[b] > 0) { bt.push_back((b+0.5)*width); bw.push_back(sw[b]); by.push_back(swy[b]); }
+    }
+
+    double pmax = cfg.pmax > 0 ? cfg.pmax : span/3;
+    std::vector<double> freqs;
+    for(double f = 1/pmax; f <= 1/cfg.pmin; f *= 1 + dmin/(cfg.oversample*span)) freqs.push_back(f);
+    std::vector<bls_peak> peaks(freqs.size());
+
+    int threads = cfg.threads > 0 ? cfg.threads : std::max(1u,std::thread::hardware_concurrency());
+    std::vector<work_slice> slices(threads);
+    for(int i=0;i<threads;i++) {
+        slices[i].lo = freqs.size()*i/threads;
+        slices[i].hi = freqs.size()*(i+1)/threads;
+    }
+    size_t nfold_max = (size_t)ceil(pmax/width) + 1;
+    size_t wrap = (size_t)ceil(dmax/width) + 2;
+
+    auto work = [&](int self) {
+        std::vector<double> fw(nfold_max), fy(nfold_max), cw(nfold_max+wrap+1), cy(nfold_max+wrap+1);
+        size_t lo, hi;
+        while(next_chunk(slices,self,16,lo,hi)) {
+            for(size_t k=lo;k<hi;k++) {
+                double f = freqs[k], period = 1/f;
+                size_t nf = (size_t)ceil(period/width);
+                double bin = period/nf;
+                std::fill(fw.begin(),fw.begin()+nf,0.0);
+                std::fill(fy.begin(),fy.begin()+nf,0.0);
+                for(size_t j=0;j<bt.size();j++) {
+                    double x = bt[j]*f;
+                    size_t i = std::min(nf-1,(size_t)((x - floor(x))*nf));
+                    fw[i] += bw[j];
+                    fy[i] += by[j];
+                }
+                size_t mmax = std::min(nf,(size_t)ceil(dmax/bin));
+                cw[0] = cy[0] = 0;
+                for(size_t i=0;i<nf+mmax;i++) {
+                    size_t b = i < nf ? i : i-nf;
+                    cw[i+1] = cw[i] + fw[b];
+                    cy[i+1] = cy[i] + fy[b];
+                }
+                bls_peak best = {period,0,0,0,0};
+                for(double dh : cfg.durations) {
+                    size_t m = std::max<size_t>(1,(size_t)llround(dh/24/bin));
+                    if(m >= nf/2) continue;
+                    for(size_t i=0;i<nf;i++) {
+                        double r = cw[i+m]-cw[i], sy = cy[i+m]-cy[i];
+                        if(sy >= 0 || r <= 0 || r >= 1) continue;
+                        double power = sy*sy/(r*(1-r));
+                        if(power > best.power) best = {period,power,-sy/(r*(1-r)),m*bin,(i+0.5*m)*bin};
+                    }
+                }
+                peaks[k] = best;
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for(int th=1;th<threads;th++) pool.emplace_back(work,th);
+    work(0);
+    for(auto& th : pool) th.join();
+    return peaks;
+}
+
+int run_bls(const char* path, const bls_config& cfg, const char* out) {
+    time_series ts;
+    auto t0 = std::chrono::steady_clock::now();
+    if(!load_time_series(path,ts)) { fprintf(stderr,"cannot read a light curve from %s\n",path); return 1; }
+    double load_s = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+    t0 = std::chrono::steady_clock::now();
+    double t_ref, baseline;
+    auto peaks = bls_search(ts,cfg,t_ref,baseline);
+    double search_s = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+    if(peaks.empty()) { fprintf(stderr,"empty period grid, check --pmin/--pmax\n"); return 1; }
+
+    FILE* f = fopen(out,"w");
+    if(!f) { fprintf(stderr,"cannot write %s\n",out); return 1; }
+    fprintf(f,"period,power,depth,duration_h,epoch\n");
+    double sum = 0, sum2 = 0;
+    size_t best = 0;
+    for(size_t k=0;k<peaks.size();k++) {
+        const bls_peak& p = peaks[k];
+        fprintf(f,"%.8f,%.6e,%.6e,%.3f,%.6f\n",p.period,p.power,p.depth,p.duration*24,t_ref+p.epoch);
+        sum += p.power;
+        sum2 += p.power*p.power;
+        if(p.power > peaks[best].power) best = k;
+    }
+    fclose(f);
+    double mean = sum/peaks.size(), sd = sqrt(fmax(0.0,sum2/peaks.size()-mean*mean));
+    const bls_peak& p = peaks[best];
+    printf("%zu cadences over %.1f d, read in %.2f s\n",ts.t.size(),baseline,load_s);
+    printf("%zu trial periods x %zu durations in %.2f s, wrote %s\n",peaks.size(),cfg.durations.size(),search_s,out);
+    printf("best: P %.6f d, epoch %.5f d, depth %.6f (%.0f ppm), duration %.2f h, SDE %.1f\n",
+           p.period,t_ref+p.epoch,p.depth,p.depth*1e6,p.duration*24,sd > 0 ? (p.power-mean)/sd : 0.0);
+    return 0;
+}
+
+int main(int argc, char** argv) {
     float star_r = 60;
     float planet_r = 12;
     float a = 180;
     float period = 8;
-    float dur_h = 4;
     float inc = 89.5;
+    float u1 = 0.4f, u2 = 0.26f;
+    long bench = 0;
+    char bls_path[256] = "", sim_path[256] = "";
+    bls_config bls;
+    long cadences = 200000;
+    double cadence_min = 2, noise_ppm = 1000, t0 = 0.3;
+    unsigned seed = 1;
+    char durations[256] = "";
+
+    bool headless = false;
+    int steps = 600;
+    float step_dt = 1/60.0f;
+    char out[256] = "lightcurve.csv";
+    for(int i=1;i<argc;i++) {
+        if(sscanf(argv[i],"--planet-r=%f",&planet_r)==1) continue;
+        if(sscanf(argv[i],"--a=%f",&a)==1) continue;
+        if(sscanf(argv[i],"--period=%f",&period)==1) continue;
+        if(sscanf(argv[i],"--inc=%f",&inc)==1) continue;
+        if(sscanf(argv[i],"--u1=%f",&u1)==1) continue;
+        if(sscanf(argv[i],"--u2=%f",&u2)==1) continue;
+        if(sscanf(argv[i],"--bench=%ld",&bench)==1) continue;
+        if(sscanf(argv[i],"--bls=%255s",bls_path)==1) continue;
+        if(sscanf(argv[i],"--pmin=%lf",&bls.pmin)==1) continue;
+        if(sscanf(argv[i],"--pmax=%lf",&bls.pmax)==1) continue;
+        if(sscanf(argv[i],"--durations=%255s",durations)==1) continue;
+        if(sscanf(argv[i],"--oversample=%lf",&bls.oversample)==1) continue;
+        if(sscanf(argv[i],"--threads=%d",&bls.threads)==1) continue;
+        if(sscanf(argv[i],"--simulate=%255s",sim_path)==1) continue;
+        if(sscanf(argv[i],"--cadences=%ld",&cadences)==1) continue;
+        if(sscanf(argv[i],"--cadence=%lf",&cadence_min)==1) continue;
+        if(sscanf(argv[i],"--noise=%lf",&noise_ppm)==1) continue;
+        if(sscanf(argv[i],"--t0=%lf",&t0)==1) continue;
+        if(sscanf(argv[i],"--seed=%u",&seed)==1) continue;
+        if(sscanf(argv[i],"--steps=%d",&steps)==1) continue;
+        if(sscanf(argv[i],"--dt=%f",&step_dt)==1) continue;
+        if(sscanf(argv[i],"--out=%255s",out)==1) continue;
+        if(std::string(argv[i])=="--headless") { headless = true; continue; }
+        fprintf(stderr,"usage: %s [--planet-r=PX --a=PX --period=D --inc=DEG --u1=U --u2=U]\n"
+                       "          [--headless --steps=N --dt=S --out=FILE] [--bench=CADENCES]\n"
+                       "          [--simulate=FILE --cadences=N --cadence=MIN --noise=PPM --t0=D --seed=N]\n"
+                       "          [--bls=FILE --pmin=D --pmax=D --durations=H,H,.. --oversample=X --threads=N --out=FILE]\n",argv[0]);
+        return 1;
+    }
+    if(durations[0]) {
+        bls.durations.clear();
+        for(char* p = durations; *p;) {
+            char* e;
+            double h = strtod(p,&e);
+            if(e == p || h <= 0) { fprintf(stderr,"bad --durations list %s\n",durations); return 1; }
+            bls.durations.push_back(h);
+            p = *e == ',' ? e+1 : e;
+        }
+    }
+    if(sim_path[0]) {
+        transit_params tp = params_of(planet_r,star_r,a,period,inc,u1,u2);
+        tp.t0 = t0;
+        return run_simulate(tp,cadences,cadence_min,noise_ppm,seed,sim_path);
+    }
+    if(bls_path[0]) return run_bls(bls_path,bls,strcmp(out,"lightcurve.csv") ? out : "periodogram.csv");
+    if(bench > 0) return run_bench(bench,u1,u2);
+    if(headless) return run_headless(planet_r,star_r,a,period,inc,u1,u2,steps,step_dt,out);
+
+    InitWindow(SCREEN_W,SCREEN_H,"Exoplanet Transit Tool");
+    SetTargetFPS(60);
 
     float ang = 0;
     bool view = true;
@@ -39,7 +526,7 @@ int main() {
 
     Vector2 cen = {SCREEN_W/2.0f, SCREEN_H/2.0f + 100};
 
-    auto curve = make_curve(period, dur_h/24.0f, depth(planet_r,star_r));
+    light_curve curve = phase_grid(period);
 
     while(!WindowShouldClose()) {
         float dt = GetFrameTime();
@@ -53,10 +540,10 @@ int main() {
         if(IsKeyPressed(KEY_P)) pause=!pause;
 
         float d = depth(planet_r,star_r);
-        curve = make_curve(period, dur_h/24.0f, d);
+        curve.update(params_of(planet_r,star_r,a,period,inc,u1,u2));
+        float dmax = fmaxf(1e-6f,1-curve.fmin);
 
-        Vector2 ppos = {cen.x + a*cosf(ang),
-                        cen.y + a*sinf(inc*DEG2RAD)*sinf(ang)};
+        Vector2 ppos = planet_pos(cen,a,inc,ang);
 
         BeginDrawing();
         ClearBackground(BLACK);
@@ -76,14 +563,15 @@ int main() {
         DrawText("Phase",gx+gw/2-50,gy+gh+20,20,LIGHTGRAY);
         DrawText("Flux ↑",gx-80,gy+20,20,LIGHTGRAY);
 
-        float phase = fmodf(ang/(2*PI)+0.5f,1);
+        float phase = orbit_phase(ang);
         float mx = gx + phase*gw;
 
-        for(size_t i=1;i<curve.size();i++) {
-            float x1 = gx + (i-1)/(float)curve.size()*gw;
-            float x2 = gx + i/(float)curve.size()*gw;
-            float y1 = gy + gh*(1 - (curve[i-1]-(1-d))/d);
-            float y2 = gy + gh*(1 - (curve[i]-(1-d))/d);
+        size_t pts = curve.flux.size();
+        for(size_t i=1;i<pts;i++) {
+            float x1 = gx + (i-1)/(float)pts*gw;
+            float x2 = gx + i/(float)pts*gw;
+            float y1 = gy + gh*(1 - (curve.flux[i-1]-(1-dmax))/dmax);
+            float y2 = gy + gh*(1 - (curve.flux[i]-(1-dmax))/dmax);
             DrawLineEx({x1,y1},{x2,y2},3.5f,SKYBLUE);
         }
 
@@ -95,9 +583,11 @@ int main() {
         DrawText("SPACE    toggle view",40,120,20,WHITE);
         DrawText("P        pause",40,150,20,WHITE);
 
-        DrawText(TextFormat("Depth %.5f (%.1f ppm)",d,d*1e6),40,200,22,YELLOW);
+        DrawText(TextFormat("Depth %.5f (%.1f ppm), (Rp/Rs)^2 %.5f",dmax,dmax*1e6,d),40,200,22,YELLOW);
         DrawText(TextFormat("Planet R %.1f Earth",planet_r/12),40,240,20,WHITE);
         DrawText(TextFormat("Period %.1f d",period),40,270,20,WHITE);
+        DrawText(TextFormat("b %.2f, duration %.2f h, u1 %.2f u2 %.2f",curve.params.a*cos(inc*DEG2RAD),
+                            transit_duration(curve.params)*24,u1,u2),40,300,20,WHITE);
 
         EndDrawing();
     }
@@ -2,41 +2,571 @@
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <string_view>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "photometry.h"
 
 const int WIDTH = 1400;
 const int HEIGHT = 900;
 
-struct StarData {
-    float temperature;
-    float luminosity;
+// Spectral classes, interned to one byte per star. D is a white dwarf.
+enum SpectralClass : uint8_t { ClassO, ClassB, ClassA, ClassF, ClassG, ClassK, ClassM, ClassD, ClassUnknown, NumClasses };
+
+const char* className(uint8_t c) {
+    static const char* names[NumClasses] = {"O", "B", "A", "F", "G", "K", "M", "D", "?"};
+    return names[std::min<uint8_t>(c, ClassUnknown)];
+}
+
+uint8_t classFromTemp(float temp) {
+    if (temp >= 30000) return ClassO;
+    if (temp >= 10000) return ClassB;
+    if (temp >= 7500) return ClassA;
+    if (temp >= 6000) return ClassF;
+    if (temp >= 5200) return ClassG;
+    if (temp >= 3700) return ClassK;
+    return ClassM;
+}
+
+// Class from a catalog string such as "G2V", "DA3" or "WN7" (Wolf-Rayet
+// stars go with O); only the leading letter is kept.
+uint8_t internClass(std::string_view s) {
+    size_t p = s.find_first_not_of(" \t\"'");
+    if (p == std::string_view::npos) return ClassUnknown;
+    switch (toupper((unsigned char)s[p])) {
+    case 'O': case 'W': return ClassO;
+    case 'B': return ClassB;
+    case 'A': return ClassA;
+    case 'F': return ClassF;
+    case 'G': return ClassG;
+    case 'K': return ClassK;
+    case 'M': return ClassM;
+    case 'D': return ClassD;
+    default: return ClassUnknown;
+    }
+}
+
+// The catalog as the renderer keeps it: log10 T, log10 L and the class,
+// 9 bytes per star. Screen positions are affine in the logs, so they are
+// recomputed with a multiply-add where needed instead of being stored.
+struct StarStore {
+    std::vector<float> logT, logL;
+    std::vector<uint8_t> cls;
+
+    size_t size() const { return logT.size(); }
+    void push(float lt, float ll, uint8_t c) {
+        logT.push_back(lt);
+        logL.push_back(ll);
+        cls.push_back(c);
+    }
+    void append(const StarStore& o) {
+        logT.insert(logT.end(), o.logT.begin(), o.logT.end());
+        logL.insert(logL.end(), o.logL.begin(), o.logL.end());
+        cls.insert(cls.end(), o.cls.begin(), o.cls.end());
+    }
+    float temperature(size_t i) const { return powf(10, logT[i]); }
+    float luminosity(size_t i) const { return powf(10, logL[i]); }
+};
+
+StarStore builtinStars() {
+    StarStore s;
+    const float data[7][2] = {{3000, 0.0001f}, {4500, 0.01f}, {6000, 1.0f}, {7500, 5.0f},
+                              {10000, 30.0f}, {20000, 1000.0f}, {40000, 50000.0f}};
+    const uint8_t cls[7] = {ClassM, ClassK, ClassG, ClassF, ClassA, ClassB, ClassO};
+    for (int i = 0; i < 7; i++) s.push(log10f(data[i][0]), log10f(data[i][1]), cls[i]);
+    return s;
+}
+
+const int originX = 100;
+const int originY = HEIGHT - 100;
+const int diagW = WIDTH - 200;
+const int diagH = HEIGHT - 200;
+
+// Axis ranges: 40000 K on the left to 3000 K, 1e-4 to 5e4 Lsun.
+const float LogTHot = log10f(40000), LogTCool = log10f(3000);
+const float LogLMin = log10f(0.0001f), LogLMax = log10f(50000);
+
+float xOfLogT(float lt) { return originX + (LogTHot - lt) / (LogTHot - LogTCool) * diagW; }
+float yOfLogL(float ll) { return originY - (ll - LogLMin) / (LogLMax - LogLMin) * diagH; }
+float tempToX(float temp) { return xOfLogT(log10f(temp)); }
+float lumToY(float lum) { return yOfLogL(log10f(lum)); }
+
+struct Placed {
+    Vector2 pos;
+    float size;
     Color color;
-    std::string spectralType;
 };
 
-std::vector<StarData> stars = {
-    {3000,   0.0001f, RED,     "M"},
-    {4500,   0.01f,   ORANGE,  "K"},
-    {6000,   1.0f,    YELLOW,  "G"},
-    {7500,   5.0f,    WHITE,   "F"},
-    {10000,  30.0f,   SKYBLUE, "A"},
-    {20000,  1000.0f, BLUE,    "B"},
-    {40000,  50000.0f,VIOLET,  "O"}
+Placed placeStar(const StarStore& s, size_t i) {
+    float size = 10 + 30 * powf(10, 0.3f * (s.logL[i] - LogLMax));
+    size = fminf(size, 60);
+    return {{xOfLogT(s.logT[i]), yOfLogL(s.logL[i])}, size, Photometry::get().colorLog(s.logT[i])};
+}
+
+// Random catalog for exercising the renderer: a main sequence (L ~ T^7 with
+// scatter), a giant branch and a white-dwarf sequence.
+StarStore makeSynthetic(size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> u(0, 1);
+    std::normal_distribution<float> scatter(0, 0.15f);
+    StarStore out;
+    for (size_t k = 0; k < n; k++) {
+        float r = u(rng), logT, logL;
+        uint8_t c;
+        if (r < 0.85f) {
+            logT = LogTCool + powf(u(rng), 3) * (LogTHot - LogTCool);
+            logL = 7 * (logT - log10f(5772)) + scatter(rng);
+            c = classFromTemp(powf(10, logT));
+        } else if (r < 0.95f) {
+            logT = log10f(3500 + 1800 * u(rng));
+            logL = 1 + 2.5f * u(rng) + scatter(rng);
+            c = classFromTemp(powf(10, logT));
+        } else {
+            logT = log10f(5000 + 30000 * u(rng));
+            logL = 4 * (logT - log10f(5772)) - 2.3f + scatter(rng);
+            c = ClassD;
+        }
+        out.push(logT, fminf(LogLMax, fmaxf(LogLMin, logL)), c);
+    }
+    return out;
+}
+
+// Header of the binary catalogs written by stellarevolution.cpp: columns of
+// mass, age, log L, log Teff (float32) and phase (uint8) follow.
+struct PopHeader {
+    char magic[8];          // "STARPOP1"
+    uint32_t version;
+    uint32_t columns;
+    uint64_t count;
+    uint64_t seed;
+    double mMin, mMax, tMax;
+};
+const uint8_t PopWhiteDwarf = 5, PopRemnant = 6;
+
+// Reads a catalog on a background thread and hands it to the render thread
+// in chunks, so the window is live from the first frame and fills in as the
+// file is read. CSV files need temperature and luminosity columns (header
+// names temperature/teff/t and luminosity/lum/l, or logteff/logt and
+// logl; without a header the first two columns) and may have a spectral
+// type column (type/spectral/sptype/spectral_type/class), otherwise the
+// class comes from the temperature. STARPOP1 binaries from
+// stellarevolution.cpp are read column-wise; NS/BH remnants are skipped.
+class CatalogLoader {
+public:
+    static const size_t ChunkStars = 1 << 16;
+
+    ~CatalogLoader() {
+        stop = true;
+        if (worker.joinable()) worker.join();
+    }
+
+    bool start(const std::string& path) {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) {
+            fprintf(stderr, "cannot open %s\n", path.c_str());
+            return false;
+        }
+        fseek(f, 0, SEEK_END);
+        total = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        PopHeader h;
+        bool pop = fread(&h, sizeof h, 1, f) == 1 && !memcmp(h.magic, "STARPOP1", 8);
+        if (!pop) fseek(f, 0, SEEK_SET);
+        worker = std::thread([this, f, pop, h] {
+            if (pop) readPop(f, h);
+            else readCSV(f);
+            fclose(f);
+            finished = true;
+        });
+        return true;
+    }
+
+    // Moves every published chunk into `into`; returns how many stars came.
+    size_t drain(StarStore& into) {
+        std::vector<StarStore> chunks;
+        {
+            std::lock_guard<std::mutex> g(lock);
+            chunks.swap(ready);
+        }
+        size_t added = 0;
+        for (auto& c : chunks) {
+            into.append(c);
+            added += c.size();
+        }
+        return added;
+    }
+
+    bool done() const { return finished; }
+    float progress() const { return total ? (float)bytesRead / total : 1; }
+    size_t skipped() const { return bad; }
+    long long bytes() const { return total; }
+
+private:
+    void publish(StarStore& chunk) {
+        if (!chunk.size()) return;
+        std::lock_guard<std::mutex> g(lock);
+        ready.push_back(std::move(chunk));
+        chunk = StarStore();
+    }
+
+    void readPop(FILE* f, const PopHeader& h) {
+        long long base = sizeof h, n = h.count;
+        std::vector<float> ll(ChunkStars), lt(ChunkStars);
+        std::vector<uint8_t> phase(ChunkStars);
+        StarStore chunk;
+        for (long long k = 0; k < n && !stop; k += ChunkStars) {
+            size_t m = (size_t)std::min<long long>(ChunkStars, n - k);
+            bool ok = fseek(f, base + 8 * n + 4 * k, SEEK_SET) == 0 && fread(ll.data(), 4, m, f) == m &&
+                      fseek(f, base + 12 * n + 4 * k, SEEK_SET) == 0 && fread(lt.data(), 4, m, f) == m &&
+                      fseek(f, base + 16 * n + k, SEEK_SET) == 0 && fread(phase.data(), 1, m, f) == m;
+            if (!ok) {
+                fprintf(stderr, "catalog truncated at star %lld\n", k);
+                break;
+            }
+            for (size_t j = 0; j < m; j++) {
+                if (phase[j] == PopRemnant) {
+                    bad++;
+                    continue;
+                }
+                chunk.push(lt[j], ll[j], phase[j] == PopWhiteDwarf ? (uint8_t)ClassD : classFromTemp(powf(10, lt[j])));
+            }
+            bytesRead = base + (k + m) * 17;
+            publish(chunk);
+        }
+    }
+
+    static bool parseFloat(std::string_view s, float& out) {
+        size_t a = s.find_first_not_of(" \t\"");
+        if (a == std::string_view::npos) return false;
+        size_t b = s.find_last_not_of(" \t\"\r");
+        auto r = std::from_chars(s.data() + a, s.data() + b + 1, out);
+        return r.ec == std::errc();
+    }
+
+    void readCSV(FILE* f) {
+        int colT = 0, colL = 1, colC = -1;
+        bool logT = false, logL = false, header = true;
+        std::vector<char> buf(1 << 20);
+        std::string carry;
+        StarStore chunk;
+        std::vector<std::string_view> fields;
+        auto line = [&](std::string_view l) {
+            if (l.empty() || l[0] == '#') return;
+            fields.clear();
+            for (size_t p = 0;;) {
+                size_t q = l.find(',', p);
+                fields.push_back(l.substr(p, q == std::string_view::npos ? q : q - p));
+                if (q == std::string_view::npos) break;
+                p = q + 1;
+            }
+            if (header) {
+                header = false;
+                float v;
+                if (parseFloat(fields[0], v)) {
+                    if (fields.size() > 2) colC = 2;
+                } else {
+                    colT = colL = -1;
+                    for (size_t c = 0; c < fields.size(); c++) {
+                        std::string name;
+                        for (char ch : fields[c])
+                            if (!isspace((unsigned char)ch) && ch != '"') name += (char)tolower((unsigned char)ch);
+                        if (name == "temperature" || name == "teff" || name == "t" || name == "temp") colT = c, logT = false;
+                        else if (name == "logteff" || name == "logt") colT = c, logT = true;
+                        else if (name == "luminosity" || name == "lum" || name == "l") colL = c, logL = false;
+                        else if (name == "logl" || name == "loglum") colL = c, logL = true;
+                        else if (name == "type" || name == "spectral" || name == "sptype" || name == "spectral_type" ||
+                                 name == "class")
+                            colC = c;
+                    }
+                    if (colT < 0 || colL < 0) {
+                        fprintf(stderr, "catalog header has no temperature/luminosity columns\n");
+                        stop = true;
+                    }
+                    return;
+                }
+            }
+            float t, lum;
+            if ((int)fields.size() <= std::max(colT, colL) || !parseFloat(fields[colT], t) ||
+                !parseFloat(fields[colL], lum) || (!logT && t <= 0) || (!logL && lum <= 0)) {
+                bad++;
+                return;
+            }
+            float lt = logT ? t : log10f(t), ll = logL ? lum : log10f(lum);
+            uint8_t c = colC >= 0 && colC < (int)fields.size() ? internClass(fields[colC]) : (uint8_t)ClassUnknown;
+            if (c == ClassUnknown) c = classFromTemp(powf(10, lt));
+            chunk.push(lt, ll, c);
+            if (chunk.size() >= ChunkStars) publish(chunk);
+        };
+        size_t got;
+        while (!stop && (got = fread(buf.data(), 1, buf.size(), f)) > 0) {
+            bytesRead += got;
+            std::string_view block(buf.data(), got);
+            size_t p = 0, nl;
+            while ((nl = block.find('\n', p)) != std::string_view::npos) {
+                if (!carry.empty()) {
+                    carry.append(block.substr(p, nl - p));
+                    line(carry);
+                    carry.clear();
+                } else {
+                    line(block.substr(p, nl - p));
+                }
+                p = nl + 1;
+                if (stop) return;
+            }
+            carry.append(block.substr(p));
+        }
+        if (!carry.empty()) line(carry);
+        publish(chunk);
+    }
+
+    std::thread worker;
+    std::mutex lock;
+    std::vector<StarStore> ready;
+    std::atomic<bool> finished{false}, stop{false};
+    std::atomic<long long> bytesRead{0};
+    std::atomic<size_t> bad{0};
+    long long total = 0;
+};
+
+// Screen-space index of the catalog. Stars are appended to the cells of a
+// coarse grid over the diagram (4 bytes each) for culling against the camera
+// view, and a fine histogram (one bin per diagram pixel at zoom 1) provides
+// both the zoomed-out density texture and, through its summed-area table,
+// the number of stars in any view rectangle in O(1). add() is incremental;
+// refresh() rebuilds the table and texture pixels from the histogram.
+class HRLayout {
+public:
+    static const int HistW = diagW, HistH = diagH, GridW = 64, GridH = 40;
+
+    HRLayout() : cells(GridW * GridH), hist(HistW * HistH, 0), rgb(3 * HistW * HistH, 0) {}
+
+    void add(const StarStore& s, size_t from) {
+        const Photometry& phot = Photometry::get();
+        for (size_t i = from; i < s.size(); i++) {
+            int bx, by;
+            bin({xOfLogT(s.logT[i]), yOfLogL(s.logL[i])}, bx, by);
+            Color c = phot.colorLog(s.logT[i]);
+            int b = by * HistW + bx;
+            hist[b]++;
+            rgb[3 * b + 0] += c.r;
+            rgb[3 * b + 1] += c.g;
+            rgb[3 * b + 2] += c.b;
+            cells[by * GridH / HistH * GridW + bx * GridW / HistW].push_back((uint32_t)i);
+        }
+    }
+
+    void refresh() {
+        sat.assign((HistW + 1) * (HistH + 1), 0);
+        for (int y = 0; y < HistH; y++)
+            for (int x = 0; x < HistW; x++)
+                sat[(y + 1) * (HistW + 1) + x + 1] = hist[y * HistW + x] + sat[y * (HistW + 1) + x + 1] +
+                                                     sat[(y + 1) * (HistW + 1) + x] - sat[y * (HistW + 1) + x];
+
+        // Mean star colour per bin, brightness by log count.
+        uint32_t peak = 1;
+        for (uint32_t c : hist) peak = std::max(peak, c);
+        pixels.assign(HistW * HistH, Color{0, 0, 0, 0});
+        for (int b = 0; b < HistW * HistH; b++) {
+            if (!hist[b]) continue;
+            float k = (0.25f + 0.75f * log1pf((float)hist[b]) / log1pf((float)peak)) / hist[b];
+            pixels[b] = {(unsigned char)(rgb[3 * b] * k), (unsigned char)(rgb[3 * b + 1] * k),
+                         (unsigned char)(rgb[3 * b + 2] * k), 255};
+        }
+    }
+
+    // Sends the pixels from the last refresh(); needs a window (GL context).
+    void upload() {
+        if (!texture.id) {
+            Image img = {pixels.data(), HistW, HistH, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+            texture = LoadTextureFromImage(img);
+        } else {
+            UpdateTexture(texture, pixels.data());
+        }
+    }
+
+    void unload() {
+        if (texture.id) UnloadTexture(texture);
+        texture = {};
+    }
+
+    // Stars whose histogram bin overlaps the world-space rectangle.
+    size_t countIn(Rectangle r) const {
+        int x0, y0, x1, y1;
+        if (sat.empty() || !binRange(r, x0, y0, x1, y1)) return 0;
+        auto at = [&](int x, int y) { return sat[y * (HistW + 1) + x]; };
+        return at(x1 + 1, y1 + 1) - at(x0, y1 + 1) - at(x1 + 1, y0) + at(x0, y0);
+    }
+
+    // Calls f(i, pos) for every star inside the world-space rectangle.
+    template <class F>
+    void forEachIn(const StarStore& s, Rectangle r, F f) const {
+        int x0, y0, x1, y1;
+        if (!binRange(r, x0, y0, x1, y1)) return;
+        for (int gy = y0 * GridH / HistH; gy <= y1 * GridH / HistH; gy++)
+            for (int gx = x0 * GridW / HistW; gx <= x1 * GridW / HistW; gx++)
+                for (uint32_t i : cells[gy * GridW + gx]) {
+                    Vector2 p = {xOfLogT(s.logT[i]), yOfLogL(s.logL[i])};
+                    if (p.x >= r.x && p.x <= r.x + r.width && p.y >= r.y && p.y <= r.y + r.height) f(i, p);
+                }
+    }
+
+    void drawDensity() const {
+        DrawTexturePro(texture, {0, 0, (float)HistW, (float)HistH},
+                       {(float)originX, (float)(originY - diagH), (float)diagW, (float)diagH}, {0, 0}, 0, WHITE);
+    }
+
+    // Drops the growth slack of the cell lists once nothing more is coming.
+    void compact() {
+        for (auto& c : cells) c.shrink_to_fit();
+    }
+
+    size_t indexBytes() const {
+        size_t b = 0;
+        for (auto& c : cells) b += c.capacity() * sizeof(uint32_t);
+        return b;
+    }
+
+private:
+    // Stars outside the axis ranges land in the edge bins.
+    static void bin(Vector2 p, int& bx, int& by) {
+        bx = std::min(HistW - 1, std::max(0, (int)((p.x - originX) * HistW / diagW)));
+        by = std::min(HistH - 1, std::max(0, (int)((p.y - (originY - diagH)) * HistH / diagH)));
+    }
+    static bool binRange(Rectangle r, int& x0, int& y0, int& x1, int& y1) {
+        if (r.x > originX + diagW || r.x + r.width < originX || r.y > originY || r.y + r.height < originY - diagH)
+            return false;
+        bin({r.x, r.y}, x0, y0);
+        bin({r.x + r.width, r.y + r.height}, x1, y1);
+        return true;
+    }
+
+    std::vector<std::vector<uint32_t>> cells;
+    std::vector<uint32_t> hist, sat;
+    std::vector<float> rgb;
+    std::vector<Color> pixels;
+    Texture2D texture = {};
 };
 
-Color tempToColor(float temp) {
-    float wl = 2.897e6f / temp;
-    if (wl < 400) return VIOLET;
-    if (wl < 450) return BLUE;
-    if (wl < 500) return SKYBLUE;
-    if (wl < 580) return WHITE;
-    if (wl < 600) return YELLOW;
-    return ORANGE;
+// Above this many stars in view the density texture is drawn instead, so a
+// frame costs the same whatever the catalog size.
+const size_t PointBudget = 20000;
+const size_t LabelBudget = 50;
+
+// World-space rectangle on screen (the camera is never rotated).
+Rectangle viewRect(const Camera2D& camera) {
+    return {camera.target.x - camera.offset.x / camera.zoom, camera.target.y - camera.offset.y / camera.zoom,
+            WIDTH / camera.zoom, HEIGHT / camera.zoom};
+}
+
+// Reads `catalog` to the end if one is given, indexes the stars, then runs
+// the per-frame view work (count, and cull when in point mode) `steps` times
+// while zooming from 0.5x to 64x around the main sequence, and writes the
+// diagram coordinates to a CSV file.
+int runHeadless(StarStore& stars, const std::string& catalog, int steps, const char* out) {
+    const Photometry& phot = Photometry::get();   // build the tables outside the timed loop
+    HRLayout layout;
+    auto t0 = std::chrono::steady_clock::now();
+    if (!catalog.empty()) {
+        CatalogLoader loader;
+        if (!loader.start(catalog)) return 1;
+        for (;;) {
+            bool done = loader.done();
+            size_t added = loader.drain(stars);
+            if (added) layout.add(stars, stars.size() - added);
+            if (done) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        layout.compact();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        printf("%s: %zu stars (%zu rows skipped) in %.3f s, %.0f MB/s, %.2f M stars/s\n", catalog.c_str(),
+               stars.size(), loader.skipped(), secs, loader.bytes() / secs / 1e6, stars.size() / secs / 1e6);
+    } else {
+        layout.add(stars, 0);
+    }
+    layout.refresh();
+    double build = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    printf("memory per star: %.1f bytes (store) + %.1f bytes (index)\n", stars.size() ? 9.0 : 0.0,
+           stars.size() ? (double)layout.indexBytes() / stars.size() : 0.0);
+
+    Camera2D camera = {0};
+    camera.offset = {WIDTH / 2.0f, HEIGHT / 2.0f};
+    camera.target = {originX + diagW * 0.6f, originY - diagH * 0.45f};
+    double busy = 0;
+    size_t pointFrames = 0, drawn = 0;
+    for (int s = 0; s < steps; ++s) {
+        camera.zoom = 0.5f * powf(128, steps > 1 ? (float)s / (steps - 1) : 0);
+        t0 = std::chrono::steady_clock::now();
+        Rectangle view = viewRect(camera);
+        if (layout.countIn(view) <= PointBudget) {
+            pointFrames++;
+            layout.forEachIn(stars, view, [&](uint32_t, Vector2) { drawn++; });
+        }
+        busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+    FILE* f = fopen(out, "w");
+    if (!f) {
+        fprintf(stderr, "cannot write %s\n", out);
+        return 1;
+    }
+    fprintf(f, "type,temperature,luminosity,x,y,size,r,g,b,M_V,B-V,BP-RP\n");
+    for (size_t i = 0; i < stars.size(); ++i) {
+        Placed p = placeStar(stars, i);
+        float t = stars.temperature(i), lum = stars.luminosity(i);
+        fprintf(f, "%s,%.1f,%g,%.3f,%.3f,%.3f,%d,%d,%d,%.3f,%.3f,%.3f\n", className(stars.cls[i]),
+                t, lum, p.pos.x, p.pos.y, p.size, p.color.r, p.color.g, p.color.b,
+                phot.absMag(BandV, t, lum), phot.colorIndex(BandB, BandV, t), phot.colorIndex(BandBP, BandRP, t));
+    }
+    fclose(f);
+    printf("%zu stars: layout + density in %.3f s; %d steps, wall time per step %.4f ms "
+           "(%zu in point mode, %zu points), wrote %s\n",
+           stars.size(), build, steps, steps ? busy / steps * 1e3 : 0.0, pointFrames, drawn, out);
+    return 0;
 }
 
-int main() {
+int main(int argc, char** argv) {
+    bool headless = false;
+    int steps = 1000;
+    char out[256] = "hr.csv";
+    char catalog[256] = "";
+    long synthetic = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (sscanf(argv[i], "--catalog=%255s", catalog) == 1) continue;
+        if (sscanf(argv[i], "--steps=%d", &steps) == 1) continue;
+        if (sscanf(argv[i], "--synthetic=%ld", &synthetic) == 1) continue;
+        if (sscanf(argv[i], "--out=%255s", out) == 1) continue;
+        if (std::string(argv[i]) == "--headless") { headless = true; continue; }
+        fprintf(stderr, "usage: %s [--catalog=FILE.csv|FILE.bin | --synthetic=N] [--headless --steps=N --out=FILE]\n",
+                argv[0]);
+        return 1;
+    }
+    StarStore stars = builtinStars();
+    if (synthetic > 0) stars = makeSynthetic(synthetic, 42);
+    if (catalog[0]) stars = StarStore();
+    if (headless) return runHeadless(stars, catalog, steps, out);
+
     InitWindow(WIDTH, HEIGHT, "Hertzsprung-Russell Diagram");
     SetTargetFPS(60);
 
+    const Photometry& phot = Photometry::get();
+    HRLayout layout;
+    layout.add(stars, 0);
+    layout.refresh();
+    layout.upload();
+
+    // The catalog streams in while the window runs; the density texture and
+    // star counts are refreshed at most four times a second until it is done.
+    CatalogLoader loader;
+    bool loading = catalog[0] && loader.start(catalog), dirty = false;
+    double lastRefresh = 0;
+
     Camera2D camera = {0};
     camera.zoom = 1.0f;
 
@@ -53,56 +583,70 @@ int main() {
         if (IsKeyPressed(KEY_L)) showLabels = !showLabels;
         if (IsKeyPressed(KEY_S)) logScale = !logScale;
 
+        if (loading) {
+            bool done = loader.done();
+            size_t added = loader.drain(stars);
+            if (added) {
+                layout.add(stars, stars.size() - added);
+                dirty = true;
+            }
+            loading = !done;
+            if (done) layout.compact();
+        }
+        if (dirty && (!loading || GetTime() - lastRefresh > 0.25)) {
+            layout.refresh();
+            layout.upload();
+            dirty = false;
+            lastRefresh = GetTime();
+        }
+
         BeginDrawing();
         ClearBackground(BLACK);
 
         BeginMode2D(camera);
 
-        int originX = 100;
-        int originY = HEIGHT - 100;
-        int diagW = WIDTH - 200;
-        int diagH = HEIGHT - 200;
-
         DrawLine(originX, originY, originX + diagW, originY, WHITE);
         DrawLine(originX, originY, originX, originY - diagH, WHITE);
 
         for (int i = 0; i <= 10; ++i) {
             float temp = 40000 * powf(10, -i / 10.0f);
-            float x = originX + (log10f(40000) - log10f(temp)) / (log10f(40000) - log10f(3000)) * diagW;
+            float x = tempToX(temp);
             DrawLine(x, originY, x, originY + 10, WHITE);
             DrawText(TextFormat("%.0f", temp), x - 20, originY + 15, 14, WHITE);
         }
 
         for (int i = -2; i <= 6; ++i) {
             float lum = powf(10, i);
-            float y = originY - (log10f(lum) - log10f(0.0001f)) / (log10f(50000) - log10f(0.0001f)) * diagH;
+            float y = lumToY(lum);
             DrawLine(originX - 10, y, originX, y, WHITE);
             DrawText(TextFormat("%g", lum), originX - 60, y - 10, 14, WHITE);
         }
 
         DrawText("Temperature (K) → decreasing", originX + diagW / 2 - 100, originY + 30, 20, LIGHTGRAY);
-        DrawText("Luminosity (L_sun) ↑ increasing", originX - 100, originY - diagH / 2 - 20, 20, Rotatef(LIGHTGRAY, -90));
+        DrawText("Luminosity (L_sun) ↑ increasing", originX - 100, originY - diagH / 2 - 20, 20, LIGHTGRAY);
 
         DrawText("Main Sequence", originX + diagW / 3, originY - diagH / 4, 24, Fade(YELLOW, 0.7f));
         DrawText("Giants", originX + diagW / 2, originY - diagH * 0.8f, 24, Fade(RED, 0.7f));
         DrawText("White Dwarfs", originX + diagW / 5, originY - diagH * 0.1f, 24, Fade(WHITE, 0.7f));
 
-        for (const auto& s : stars) {
-            float logTemp = log10f(s.temperature);
-            float x = originX + (log10f(40000) - logTemp) / (log10f(40000) - log10f(3000)) * diagW;
-
-            float logLum = log10f(s.luminosity);
-            float y = originY - (logLum - log10f(0.0001f)) / (log10f(50000) - log10f(0.0001f)) * diagH;
-
-            float size = 10 + 30 * powf(s.luminosity / 50000.0f, 0.3f);
-            size = fminf(size, 60);
-
-            Color col = tempToColor(s.temperature);
-            DrawCircle(x, y, size, col);
-
-            if (showLabels) {
-                DrawText(s.spectralType.c_str(), x - 10, y - size - 25, 20, WHITE);
-            }
+        Rectangle view = viewRect(camera);
+        size_t visible = layout.countIn(view);
+        if (visible > PointBudget) {
+            layout.drawDensity();
+        } else {
+            // Few stars in view: full-size discs with labels, otherwise dots
+            // a constant 3 px on screen.
+            bool discs = visible <= LabelBudget;
+            float dot = 1.5f / camera.zoom;
+            layout.forEachIn(stars, view, [&](uint32_t i, Vector2 p) {
+                if (discs) {
+                    Placed pl = placeStar(stars, i);
+                    DrawCircle(p.x, p.y, pl.size, pl.color);
+                    if (showLabels) DrawText(className(stars.cls[i]), p.x - 10, p.y - pl.size - 25, 20, WHITE);
+                } else {
+                    DrawRectangleRec({p.x - dot, p.y - dot, 2 * dot, 2 * dot}, phot.colorLog(stars.logT[i]));
+                }
+            });
         }
 
         EndMode2D();
@@ -110,10 +654,14 @@ int main() {
         DrawText("Arrows / Middle mouse wheel - Pan & Zoom", 10, 10, 20, LIME);
         DrawText("L - Toggle spectral labels", 10, 40, 20, LIME);
         DrawText("S - Toggle log scale hint (visual only)", 10, 70, 20, LIME);
+        DrawText(TextFormat("%zu stars, %zu in view (%s), %d FPS", stars.size(), visible,
+                            visible > PointBudget ? "density" : "points", GetFPS()), 10, 100, 20, LIME);
+        if (loading) DrawText(TextFormat("loading %s: %.0f%%", catalog, 100 * loader.progress()), 10, 130, 20, YELLOW);
 
         EndDrawing();
     }
 
+    layout.unload();
     CloseWindow();
     return 0;
 }
\ No newline at end of file
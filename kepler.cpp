@@ -2,6 +2,22 @@
 #include <cmath>
 #include <vector>
 #include <cstdio>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <immintrin.h>
+#include <charconv>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -13,30 +29,1016 @@ struct Body {
     double a, e, i, lan, argp, m0;
 };
 
+const double KeplerTol = 1e-14;
+
+// Reduces m to [-pi, pi].
+double wrapPi(double m) {
+    return m - 2 * M_PI * nearbyint(m / (2 * M_PI));
+}
+
+// Eccentric anomaly for 0 <= e < 1. Danby's starting guess E0 = M + 0.85 e
+// sign(sin M) followed by Halley steps until the correction drops below
+// KeplerTol; at most a handful of steps even for e close to 1.
 double solve(double m, double e) {
-    double E = m;
-    for (int i = 0; i < 10; i++) {
-        E = E - (E - e * sin(E) - m) / (1 - e * cos(E));
+    m = wrapPi(m);
+    double E = m + 0.85 * e * (sin(m) >= 0 ? 1 : -1);
+    for (int i = 0; i < 50; i++) {
+        double s = e * sin(E), c = e * cos(E);
+        double f = E - s - m, fp = 1 - c;
+        double d = f * fp / (fp * fp - 0.5 * f * s);
+        E -= d;
+        if (fabs(d) < KeplerTol) break;
     }
     return E;
 }
 
+// Orbital elements for many bodies as columns, with everything that does not
+// depend on time precomputed: mean motion, semi-minor axis and the P/Q unit
+// vectors that rotate the orbital plane into heliocentric ecliptic axes.
+// Angles in degrees on input, distances in AU, time in days. Times passed to
+// the propagators are absolute (JD for real catalogs); each body is moved from
+// its own epoch, and an epoch of 0 means "at t0".
+struct Elements {
+    size_t n = 0;
+    double t0 = 0;                              // time origin of the set
+    vector<double> a, e, i, lan, argp, m0;      // as given (angles in radians)
+    vector<double> epoch;                       // JD of m0; 0 when unknown
+    vector<double> b, mm;                       // a sqrt(1-e^2), mean motion rad/day
+    vector<double> px, py, pz, qx, qy, qz;
+
+    vector<vector<double>*> columns() {
+        return {&a, &e, &i, &lan, &argp, &m0, &epoch, &b, &mm, &px, &py, &pz, &qx, &qy, &qz};
+    }
+    void resize(size_t count) {
+        n = count;
+        for (auto* v : columns()) v->assign(n, 0);
+    }
+
+    void set(size_t k, const Body& body) {
+        a[k] = body.a;
+        e[k] = body.e;
+        i[k] = body.i * M_PI / 180.0;
+        lan[k] = body.lan * M_PI / 180.0;
+        argp[k] = body.argp * M_PI / 180.0;
+        m0[k] = body.m0 * M_PI / 180.0;
+    }
+
+    double epochOf(size_t k) const { return epoch[k] != 0 ? epoch[k] : t0; }
+    double meanAnomaly(size_t k, double t) const { return m0[k] + mm[k] * (t - epochOf(k)); }
+
+    void push(const Body& body) {
+        resize(n + 1);
+        set(n - 1, body);
+        prepare(n - 1, n);
+    }
+
+    void prepare(size_t k0, size_t k1) {
+        double mu = G * MSun;
+        for (size_t k = k0; k < k1; k++) {
+            b[k] = a[k] * sqrt(1 - e[k] * e[k]);
+            mm[k] = sqrt(mu / pow(a[k] * AU, 3)) * 86400;
+            double cw = cos(argp[k]), sw = sin(argp[k]);
+            double cO = cos(lan[k]), sO = sin(lan[k]);
+            double ci = cos(i[k]), si = sin(i[k]);
+            px[k] = cw * cO - sw * sO * ci;
+            py[k] = cw * sO + sw * cO * ci;
+            pz[k] = sw * si;
+            qx[k] = -sw * cO - cw * sO * ci;
+            qy[k] = -sw * sO + cw * cO * ci;
+            qz[k] = cw * si;
+        }
+    }
+};
+
+// Heliocentric ecliptic positions (AU) and velocities (AU/day).
+struct States {
+    vector<double> x, y, z, vx, vy, vz;
+    void resize(size_t n) {
+        for (auto* v : {&x, &y, &z, &vx, &vy, &vz}) v->resize(n);
+    }
+};
+
+// Position and velocity from the orbital-plane coordinates at anomaly E.
+inline void orbitState(const Elements& el, size_t k, double E, double* r, double* v) {
+    double sE = sin(E), cE = cos(E);
+    double xo = el.a[k] * (cE - el.e[k]), yo = el.b[k] * sE;
+    double edot = el.mm[k] / (1 - el.e[k] * cE);
+    double vxo = -el.a[k] * sE * edot, vyo = el.b[k] * cE * edot;
+    r[0] = el.px[k] * xo + el.qx[k] * yo;
+    r[1] = el.py[k] * xo + el.qy[k] * yo;
+    r[2] = el.pz[k] * xo + el.qz[k] * yo;
+    v[0] = el.px[k] * vxo + el.qx[k] * vyo;
+    v[1] = el.py[k] * vxo + el.qy[k] * vyo;
+    v[2] = el.pz[k] * vxo + el.qz[k] * vyo;
+}
+
+inline void place(const Elements& el, size_t k, double E, States& s) {
+    double r[3], v[3];
+    orbitState(el, k, E, r, v);
+    s.x[k] = r[0];
+    s.y[k] = r[1];
+    s.z[k] = r[2];
+    s.vx[k] = v[0];
+    s.vy[k] = v[1];
+    s.vz[k] = v[2];
+}
+
+void propagateScalar(const Elements& el, double t, States& s, size_t k0, size_t k1) {
+    for (size_t k = k0; k < k1; k++) place(el, k, solve(el.meanAnomaly(k, t), el.e[k]), s);
+}
+
+// sin and cos of 4 doubles, |x| up to a few hundred. Quadrant reduction by
+// pi/2 in two parts, then odd/even polynomials on |r| <= pi/4 (truncation
+// below 1e-16).
+__attribute__((target("avx2,fma")))
+static inline void sincosAVX2(__m256d x, __m256d& s, __m256d& c) {
+    __m256d q = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(2 / M_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(q, _mm256_set1_pd(1.5707963267948966), x);
+    r = _mm256_fnmadd_pd(q, _mm256_set1_pd(6.123233995736766e-17), r);
+    __m256d r2 = _mm256_mul_pd(r, r);
+
+    __m256d ps = _mm256_set1_pd(-1.0 / 1307674368000.0);
+    __m256d pc = _mm256_set1_pd(1.0 / 20922789888000.0);
+    const double sc[] = {1.0 / 6227020800.0, -1.0 / 39916800.0, 1.0 / 362880.0, -1.0 / 5040.0, 1.0 / 120.0, -1.0 / 6.0};
+    const double cc[] = {-1.0 / 87178291200.0, 1.0 / 479001600.0, -1.0 / 3628800.0, 1.0 / 40320.0, -1.0 / 720.0, 1.0 / 24.0, -0.5};
+    for (double k : sc) ps = _mm256_fmadd_pd(ps, r2, _mm256_set1_pd(k));
+    for (double k : cc) pc = _mm256_fmadd_pd(pc, r2, _mm256_set1_pd(k));
+    __m256d sr = _mm256_fmadd_pd(_mm256_mul_pd(ps, r2), r, r);
+    __m256d cr = _mm256_fmadd_pd(pc, r2, _mm256_set1_pd(1.0));
+
+    __m256i qi = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(q));
+    __m256d swap = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(qi, _mm256_set1_epi64x(1)), _mm256_set1_epi64x(1)));
+    __m256d sgnS = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(qi, _mm256_set1_epi64x(2)), 62));
+    __m256d sgnC = _mm256_castsi256_pd(_mm256_slli_epi64(
+        _mm256_and_si256(_mm256_add_epi64(qi, _mm256_set1_epi64x(1)), _mm256_set1_epi64x(2)), 62));
+    s = _mm256_xor_pd(_mm256_blendv_pd(sr, cr, swap), sgnS);
+    c = _mm256_xor_pd(_mm256_blendv_pd(cr, sr, swap), sgnC);
+}
+
+// p * u + q * v for one ecliptic axis.
+__attribute__((target("avx2,fma")))
+static inline __m256d rotAVX2(const double* p, const double* q, __m256d u, __m256d v) {
+    return _mm256_fmadd_pd(_mm256_loadu_pd(p), u, _mm256_mul_pd(_mm256_loadu_pd(q), v));
+}
+
+// Four bodies per iteration; lanes iterate together until every one has
+// converged. Lanes that have not converged after 8 Halley steps (never seen
+// for e < 0.999) are redone with the scalar solver. Returns how many.
+__attribute__((target("avx2,fma")))
+size_t propagateAVX2(const Elements& el, double time, States& st, size_t k0, size_t k1) {
+    size_t fallback = 0, k = k0;
+    const __m256d twoPi = _mm256_set1_pd(2 * M_PI), invTwoPi = _mm256_set1_pd(1 / (2 * M_PI));
+    const __m256d t = _mm256_set1_pd(time), t0 = _mm256_set1_pd(el.t0), tol = _mm256_set1_pd(KeplerTol);
+    const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+    for (; k + 4 <= k1; k += 4) {
+        __m256d e = _mm256_loadu_pd(&el.e[k]);
+        __m256d ep = _mm256_loadu_pd(&el.epoch[k]);
+        ep = _mm256_blendv_pd(ep, t0, _mm256_cmp_pd(ep, _mm256_setzero_pd(), _CMP_EQ_OQ));
+        __m256d m = _mm256_fmadd_pd(_mm256_loadu_pd(&el.mm[k]), _mm256_sub_pd(t, ep), _mm256_loadu_pd(&el.m0[k]));
+        m = _mm256_fnmadd_pd(_mm256_round_pd(_mm256_mul_pd(m, invTwoPi), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC), twoPi, m);
+
+        __m256d sm, cm;
+        sincosAVX2(m, sm, cm);
+        __m256d kick = _mm256_mul_pd(_mm256_set1_pd(0.85), e);
+        kick = _mm256_blendv_pd(kick, _mm256_sub_pd(_mm256_setzero_pd(), kick), _mm256_cmp_pd(sm, _mm256_setzero_pd(), _CMP_LT_OQ));
+        __m256d E = _mm256_add_pd(m, kick);
+
+        __m256d sE, cE;
+        int done = 0;
+        for (int it = 0; it < 8 && done != 0xf; it++) {
+            sincosAVX2(E, sE, cE);
+            __m256d es = _mm256_mul_pd(e, sE);
+            __m256d f = _mm256_sub_pd(_mm256_sub_pd(E, es), m);
+            __m256d fp = _mm256_fnmadd_pd(e, cE, _mm256_set1_pd(1.0));
+            __m256d den = _mm256_fnmadd_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), f), es, _mm256_mul_pd(fp, fp));
+            __m256d d = _mm256_div_pd(_mm256_mul_pd(f, fp), den);
+            E = _mm256_sub_pd(E, d);
+            done = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_and_pd(d, absMask), tol, _CMP_LT_OQ));
+        }
+        sincosAVX2(E, sE, cE);
+
+        __m256d a = _mm256_loadu_pd(&el.a[k]), b = _mm256_loadu_pd(&el.b[k]);
+        __m256d xo = _mm256_mul_pd(a, _mm256_sub_pd(cE, e)), yo = _mm256_mul_pd(b, sE);
+        __m256d edot = _mm256_div_pd(_mm256_loadu_pd(&el.mm[k]), _mm256_fnmadd_pd(e, cE, _mm256_set1_pd(1.0)));
+        __m256d vxo = _mm256_mul_pd(_mm256_sub_pd(_mm256_setzero_pd(), _mm256_mul_pd(a, sE)), edot);
+        __m256d vyo = _mm256_mul_pd(_mm256_mul_pd(b, cE), edot);
+        _mm256_storeu_pd(&st.x[k], rotAVX2(&el.px[k], &el.qx[k], xo, yo));
+        _mm256_storeu_pd(&st.y[k], rotAVX2(&el.py[k], &el.qy[k], xo, yo));
+        _mm256_storeu_pd(&st.z[k], rotAVX2(&el.pz[k], &el.qz[k], xo, yo));
+        _mm256_storeu_pd(&st.vx[k], rotAVX2(&el.px[k], &el.qx[k], vxo, vyo));
+        _mm256_storeu_pd(&st.vy[k], rotAVX2(&el.py[k], &el.qy[k], vxo, vyo));
+        _mm256_storeu_pd(&st.vz[k], rotAVX2(&el.pz[k], &el.qz[k], vxo, vyo));
+
+        if (done != 0xf)
+            for (int l = 0; l < 4; l++)
+                if (!(done >> l & 1)) {
+                    place(el, k + l, solve(el.meanAnomaly(k + l, time), el.e[k + l]), st);
+                    fallback++;
+                }
+    }
+    propagateScalar(el, time, st, k, k1);
+    return fallback;
+}
+
+bool hasAVX2() {
+    static bool ok = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return ok;
+}
+
+// States of every body at time t.
+size_t propagate(const Elements& el, double t, States& s, bool simd = true) {
+    s.resize(el.n);
+    if (simd && hasAVX2()) return propagateAVX2(el, t, s, 0, el.n);
+    propagateScalar(el, t, s, 0, el.n);
+    return 0;
+}
+
+// Default time origin of a catalog: its latest element epoch (0 if none).
+double referenceEpoch(const Elements& el) {
+    double t = 0;
+    for (double e : el.epoch) t = max(t, e);
+    return t;
+}
+
+// Catalog ingest. The file is memory-mapped and cut into one chunk per thread
+// at line boundaries; each thread parses its lines with from_chars into its
+// own buffer, and the buffers are copied into the column store in file order.
+// Lines that do not parse (MPCORB headers, blank lines) are skipped.
+struct Parsed {
+    vector<Body> bodies;
+    vector<double> epochs;
+};
+
+static bool number(string_view s, double& out) {
+    size_t p = 0;
+    while (p < s.size() && s[p] == ' ') p++;
+    if (p < s.size() && s[p] == '+') p++;
+    auto r = from_chars(s.data() + p, s.data() + s.size(), out);
+    return r.ec == errc() && r.ptr != s.data() + p;
+}
+
+// MPC packed epoch (e.g. K24AH = 2024 Oct 17) to JD at 0h TT.
+static double packedEpochJD(string_view p) {
+    auto digit = [](char ch) { return ch <= '9' ? ch - '0' : ch - 'A' + 10; };
+    if (p.size() < 5) return 0;
+    int y = (p[0] - 'I' + 18) * 100 + (p[1] - '0') * 10 + (p[2] - '0');
+    int mo = digit(p[3]), d = digit(p[4]);
+    int a = (14 - mo) / 12, yy = y + 4800 - a, mm = mo + 12 * a - 3;
+    return d + (153 * mm + 2) / 5 + 365 * yy + yy / 4 - yy / 100 + yy / 400 - 32045 - 0.5;
+}
+
+// Fixed-width MPCORB record (1-based columns): epoch 21-25, M 27-35,
+// peri 38-46, node 49-57, incl 60-68, e 71-79, a 93-103.
+static bool parseMPC(string_view l, Body& b, double& epoch) {
+    if (l.size() < 103) return false;
+    if (!number(l.substr(26, 9), b.m0) || !number(l.substr(37, 9), b.argp) || !number(l.substr(48, 9), b.lan) ||
+        !number(l.substr(59, 9), b.i) || !number(l.substr(70, 9), b.e) || !number(l.substr(92, 11), b.a))
+        return false;
+    epoch = packedEpochJD(l.substr(20, 5));
+    return b.a > 0 && b.e >= 0 && b.e < 1;
+}
+
+// CSV columns located by header name: a, e, i, om|node|lan, w|peri|argp,
+// ma|m|m0 and optionally epoch (JD).
+struct CsvLayout {
+    int col[7] = {-1, -1, -1, -1, -1, -1, -1};
+    int width = 0;
+
+    bool fromHeader(string_view h) {
+        const vector<vector<string>> names = {{"a"}, {"e"}, {"i", "incl"}, {"om", "node", "lan"},
+                                              {"w", "peri", "argp"}, {"ma", "m", "m0"}, {"epoch"}};
+        int c = 0;
+        for (size_t p = 0; p <= h.size(); c++) {
+            size_t q = min(h.find(',', p), h.size());
+            string name(h.substr(p, q - p));
+            name.erase(remove_if(name.begin(), name.end(), [](char ch) { return ch == ' ' || ch == '"' || ch == '\r'; }), name.end());
+            for (auto& ch : name) ch = tolower(ch);
+            for (int k = 0; k < 7; k++)
+                for (auto& n : names[k])
+                    if (name == n && col[k] < 0) col[k] = c;
+            p = q + 1;
+        }
+        width = c;
+        return *min_element(col, col + 6) >= 0;
+    }
+
+    bool parse(string_view l, Body& b, double& epoch) const {
+        string_view f[64];
+        int c = 0;
+        for (size_t p = 0; p <= l.size() && c < 64; c++) {
+            size_t q = min(l.find(',', p), l.size());
+            f[c] = l.substr(p, q - p);
+            p = q + 1;
+        }
+        double v[7] = {0, 0, 0, 0, 0, 0, 0};
+        for (int k = 0; k < 7; k++)
+            if (col[k] >= 0 && (col[k] >= c || !number(f[col[k]], v[k]))) {
+                if (k < 6) return false;
+                v[k] = 0;
+            }
+        b = {v[0], v[1], v[2], v[3], v[4], v[5]};
+        epoch = v[6];
+        return b.a > 0 && b.e >= 0 && b.e < 1;
+    }
+};
+
+bool loadCatalog(const string& path, Elements& el, int threads) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "cannot open %s\n", path.c_str());
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "cannot stat %s\n", path.c_str());
+        close(fd);
+        return false;
+    }
+    size_t bytes = st.st_size;
+    if (bytes == 0) {
+        close(fd);
+        el.resize(0);
+        return true;
+    }
+    const char* data = (const char*)mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "cannot map %s\n", path.c_str());
+        return false;
+    }
+    madvise((void*)data, bytes, MADV_SEQUENTIAL);
+    string_view all(data, bytes);
+
+    size_t firstEnd = min(all.find('\n'), bytes);
+    CsvLayout csv;
+    bool isCsv = all.substr(0, firstEnd).find(',') != string_view::npos;
+    size_t start = 0;
+    if (isCsv) {
+        if (!csv.fromHeader(all.substr(0, firstEnd))) {
+            fprintf(stderr, "%s: CSV header needs a, e, i, om, w, ma columns\n", path.c_str());
+            munmap((void*)data, bytes);
+            return false;
+        }
+        start = min(firstEnd + 1, bytes);
+    }
+
+    threads = max(1, threads);
+    vector<size_t> cut(threads + 1, bytes);
+    cut[0] = start;
+    for (int t = 1; t < threads; t++) {
+        size_t p = max({cut[t - 1], start + (bytes - start) * t / threads, start + 1});
+        while (p < bytes && data[p - 1] != '\n') p++;
+        cut[t] = p;
+    }
+    vector<Parsed> parts(threads);
+    auto work = [&](int t) {
+        Parsed& out = parts[t];
+        out.bodies.reserve((cut[t + 1] - cut[t]) / (isCsv ? 60 : 200) + 16);
+        Body b;
+        double ep;
+        for (size_t p = cut[t]; p < cut[t + 1];) {
+            size_t q = min(all.find('\n', p), cut[t + 1]);
+            string_view line = all.substr(p, q - p);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (isCsv ? csv.parse(line, b, ep) : parseMPC(line, b, ep)) {
+                out.bodies.push_back(b);
+                out.epochs.push_back(ep);
+            }
+            p = q + 1;
+        }
+    };
+    vector<thread> pool;
+    for (int t = 1; t < threads; t++) pool.emplace_back(work, t);
+    work(0);
+    for (auto& th : pool) th.join();
+    munmap((void*)data, bytes);
+
+    vector<size_t> offset(threads + 1, 0);
+    for (int t = 0; t < threads; t++) offset[t + 1] = offset[t] + parts[t].bodies.size();
+    el.resize(offset[threads]);
+    auto fill = [&](int t) {
+        for (size_t k = 0; k < parts[t].bodies.size(); k++) {
+            el.set(offset[t] + k, parts[t].bodies[k]);
+            el.epoch[offset[t] + k] = parts[t].epochs[k];
+        }
+        el.prepare(offset[t], offset[t + 1]);
+    };
+    pool.clear();
+    for (int t = 1; t < threads; t++) pool.emplace_back(fill, t);
+    fill(0);
+    for (auto& th : pool) th.join();
+    return true;
+}
+
+// Binary cache: header, then every Elements column (raw and precomputed)
+// back to back, so loading is one read per column and no parsing.
+struct CacheHeader {
+    char magic[8];          // "KEPLCACH"
+    uint32_t version;       // 1
+    uint32_t columns;
+    uint64_t count;
+};
+
+bool saveCache(const string& path, Elements& el) {
+    string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) {
+        fprintf(stderr, "cannot write %s\n", tmp.c_str());
+        return false;
+    }
+    auto cols = el.columns();
+    CacheHeader h = {};
+    memcpy(h.magic, "KEPLCACH", 8);
+    h.version = 1;
+    h.columns = cols.size();
+    h.count = el.n;
+    bool ok = fwrite(&h, sizeof h, 1, f) == 1;
+    for (auto* c : cols) ok = ok && fwrite(c->data(), sizeof(double), el.n, f) == el.n;
+    ok = fclose(f) == 0 && ok;
+    return ok && rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool loadCache(const string& path, Elements& el) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    CacheHeader h;
+    auto cols = el.columns();
+    struct stat st;
+    bool ok = fstat(fileno(f), &st) == 0 && fread(&h, sizeof h, 1, f) == 1 && !memcmp(h.magic, "KEPLCACH", 8) &&
+              h.version == 1 && h.columns == cols.size() && h.count <= (uint64_t)st.st_size / sizeof(double) &&
+              (uint64_t)st.st_size == sizeof h + h.count * sizeof(double) * cols.size();
+    if (ok) {
+        el.n = h.count;
+        for (auto* c : cols) {
+            c->resize(el.n);
+            ok = ok && fread(c->data(), sizeof(double), el.n, f) == el.n;
+        }
+    }
+    fclose(f);
+    if (!ok) fprintf(stderr, "%s is not a valid element cache\n", path.c_str());
+    return ok;
+}
+
+// Sums c[k] T[k] and c[k] dT[k] for the three axes of one body; `stride` is a
+// multiple of 4 and the padding coefficients are zero.
+__attribute__((target("avx2,fma")))
+static void chebBodyAVX2(const double* c, const double* T, const double* dT, int stride, double* r, double* v) {
+    for (int a = 0; a < 3; a++, c += stride) {
+        __m256d p = _mm256_setzero_pd(), q = _mm256_setzero_pd();
+        for (int k = 0; k < stride; k += 4) {
+            __m256d ck = _mm256_loadu_pd(c + k);
+            p = _mm256_fmadd_pd(ck, _mm256_loadu_pd(T + k), p);
+            q = _mm256_fmadd_pd(ck, _mm256_loadu_pd(dT + k), q);
+        }
+        __m256d h = _mm256_hadd_pd(p, q);
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(h), _mm256_extractf128_pd(h, 1));
+        r[a] = _mm_cvtsd_f64(s);
+        v[a] = _mm_cvtsd_f64(_mm_unpackhi_pd(s, s));
+    }
+}
+
+static void chebBody(const double* c, const double* T, const double* dT, int degree, int stride, double* r, double* v) {
+    for (int a = 0; a < 3; a++, c += stride) {
+        double p = 0, q = 0;
+        for (int k = 0; k < degree; k++) {
+            p += c[k] * T[k];
+            q += c[k] * dT[k];
+        }
+        r[a] = p;
+        v[a] = q;
+    }
+}
+
+// Piecewise Chebyshev ephemeris over [t0, t0 + span] days (same time origin
+// as propagate()). Every body shares the segment grid, and coefficients are
+// stored segment-major, [seg][body][axis][k], so evaluating all bodies at one
+// time walks a single contiguous block and one body over a segment touches
+// 3 * stride doubles. Velocities come from the same coefficients through the
+// derivative recurrence.
+struct Ephemeris {
+    double t0 = 0, span = 0, len = 0;
+    int degree = 0, stride = 0;     // coefficients per axis, padded to 4
+    size_t bodies = 0, segs = 0;
+    vector<double> coef;
+    double maxErr = 0;              // worst position error found by check(), AU
+
+    const double* block(size_t seg, size_t body) const {
+        return &coef[((seg * bodies) + body) * 3 * stride];
+    }
+
+    // Segment index and the T_k(tau), dT_k/dt terms for time t.
+    size_t basis(double t, double* T, double* dT) const {
+        double u = (t - t0) / len;
+        size_t seg = min((size_t)max(0.0, floor(u)), segs - 1);
+        double tau = 2 * (u - seg) - 1, scale = 2 / len;
+        T[0] = 1;
+        T[1] = tau;
+        dT[0] = 0;
+        dT[1] = scale;
+        for (int k = 2; k < degree; k++) {
+            T[k] = 2 * tau * T[k - 1] - T[k - 2];
+            dT[k] = 2 * scale * T[k - 1] + 2 * tau * dT[k - 1] - dT[k - 2];
+        }
+        for (int k = degree; k < stride; k++) T[k] = dT[k] = 0;
+        return seg;
+    }
+
+    void eval(size_t body, double t, double* r, double* v) const {
+        double T[64], dT[64];
+        const double* c = block(basis(t, T, dT), body);
+        if (hasAVX2()) chebBodyAVX2(c, T, dT, stride, r, v);
+        else chebBody(c, T, dT, degree, stride, r, v);
+    }
+
+    void evalAll(double t, States& s) const {
+        double T[64], dT[64], r[3], v[3];
+        size_t seg = basis(t, T, dT);
+        s.resize(bodies);
+        bool simd = hasAVX2();
+        for (size_t b = 0; b < bodies; b++) {
+            const double* c = block(seg, b);
+            if (simd) chebBodyAVX2(c, T, dT, stride, r, v);
+            else chebBody(c, T, dT, degree, stride, r, v);
+            s.x[b] = r[0];
+            s.y[b] = r[1];
+            s.z[b] = r[2];
+            s.vx[b] = v[0];
+            s.vy[b] = v[1];
+            s.vz[b] = v[2];
+        }
+    }
+
+    // Interpolates at the `degree` Chebyshev nodes of each segment, using the
+    // analytic propagator. Segments are split across threads.
+    void fit(const Elements& el, int threads) {
+        coef.assign(segs * bodies * 3 * stride, 0);
+        auto work = [&](int th) {
+            States st;
+            vector<double> f(3 * degree * bodies), basis(degree * degree);
+            for (int k = 0; k < degree; k++)
+                for (int j = 0; j < degree; j++)
+                    basis[k * degree + j] = cos(M_PI * k * (j + 0.5) / degree) * (k ? 2.0 : 1.0) / degree;
+            for (size_t sg = th; sg < segs; sg += threads) {
+                for (int j = 0; j < degree; j++) {
+                    double x = cos(M_PI * (j + 0.5) / degree);
+                    propagate(el, t0 + (sg + 0.5 * (x + 1)) * len, st);
+                    for (size_t b = 0; b < bodies; b++) {
+                        f[(b * 3 + 0) * degree + j] = st.x[b];
+                        f[(b * 3 + 1) * degree + j] = st.y[b];
+                        f[(b * 3 + 2) * degree + j] = st.z[b];
+                    }
+                }
+                for (size_t b = 0; b < bodies; b++)
+                    for (int a = 0; a < 3; a++) {
+                        double* c = &coef[((sg * bodies + b) * 3 + a) * stride];
+                        const double* fv = &f[(b * 3 + a) * degree];
+                        for (int k = 0; k < degree; k++) {
+                            double sum = 0;
+                            for (int j = 0; j < degree; j++) sum += fv[j] * basis[k * degree + j];
+                            c[k] = sum;
+                        }
+                    }
+            }
+        };
+        vector<thread> pool;
+        for (int th = 1; th < threads; th++) pool.emplace_back(work, th);
+        work(0);
+        for (auto& t : pool) t.join();
+    }
+
+    // Largest position error against the analytic solution, sampled at
+    // `perSeg` points per segment that are not interpolation nodes.
+    double check(const Elements& el, int perSeg) const {
+        States ref, got;
+        double worst = 0;
+        for (size_t sg = 0; sg < segs; sg++)
+            for (int j = 0; j < perSeg; j++) {
+                double t = t0 + (sg + (j + 0.37) / perSeg) * len;
+                propagate(el, t, ref);
+                evalAll(t, got);
+                for (size_t b = 0; b < bodies; b++) {
+                    double dx = got.x[b] - ref.x[b], dy = got.y[b] - ref.y[b], dz = got.z[b] - ref.z[b];
+                    worst = max(worst, sqrt(dx * dx + dy * dy + dz * dz));
+                }
+            }
+        return worst;
+    }
+};
+
+// Builds with segments of `segDays`, halving them until check() is within
+// `tol` AU (or the segments get shorter than a minute).
+Ephemeris buildEphemeris(const Elements& el, double t0, double span, double segDays, int degree, double tol, int threads) {
+    Ephemeris eph;
+    eph.t0 = t0;
+    eph.span = span;
+    eph.degree = max(2, min(64, degree));
+    eph.stride = (eph.degree + 3) & ~3;
+    eph.bodies = el.n;
+    for (double len = segDays;; len /= 2) {
+        eph.segs = max(1.0, ceil(span / len));
+        eph.len = span / eph.segs;
+        eph.fit(el, max(1, threads));
+        eph.maxErr = eph.check(el, 2 * eph.degree);
+        if (eph.maxErr <= tol || eph.len < 1.0 / 1440) break;
+    }
+    return eph;
+}
+
+// Close-approach screening. The window [t0, t1] is cut into steps; step s
+// samples every body at its midpoint and owns the minima that fall inside it.
+// A body moves at most reach = v_peri * step / 2 from its sampled position
+// during its step, so a pair can only come within `dist` during the step if
+// the sampled separation is below dist + reach_i + reach_j. Candidates come
+// from a 3D spatial hash whose cells fit the 99th-percentile reach; the
+// faster bodies scan a wider block of cells. Each candidate's separation
+// minimum is then refined by a safeguarded Newton iteration on
+// g(t) = dr . dv, the derivative of |dr|^2 / 2.
+struct Approach {
+    uint32_t a, b;
+    double t, dist;
+};
+
+// Heliocentric state of one body at time t.
+void stateOf(const Elements& el, size_t k, double t, double* r, double* v) {
+    orbitState(el, k, solve(el.meanAnomaly(k, t), el.e[k]), r, v);
+}
+
+class ApproachGrid {
+public:
+    void build(const States& s, double cellSize) {
+        cell = cellSize;
+        size_t n = s.x.size(), size = 1;
+        while (size < 2 * n) size <<= 1;
+        heads.assign(size, -1);
+        next.resize(n);
+        cx.resize(n);
+        cy.resize(n);
+        cz.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            cx[i] = cellOf(s.x[i]);
+            cy[i] = cellOf(s.y[i]);
+            cz[i] = cellOf(s.z[i]);
+            size_t h = slot(cx[i], cy[i], cz[i]);
+            next[i] = heads[h];
+            heads[h] = (int)i;
+        }
+    }
+
+    // Calls f(i, j) once for every pair closer than dist + reach[i] + reach[j].
+    // The pair is found from the body with the larger reach (ties: lower
+    // index), which scans enough cells to cover twice its own reach.
+    template <class F>
+    void candidates(const States& s, const vector<double>& reach, double dist, F f) const {
+        size_t n = s.x.size();
+        for (size_t i = 0; i < n; i++) {
+            int m = max(1, (int)ceil((dist + 2 * reach[i]) / cell));
+            for (int dz = -m; dz <= m; dz++)
+                for (int dy = -m; dy <= m; dy++)
+                    for (int dx = -m; dx <= m; dx++) {
+                        int x = cx[i] + dx, y = cy[i] + dy, z = cz[i] + dz;
+                        for (int j = heads[slot(x, y, z)]; j >= 0; j = next[j]) {
+                            if (cx[j] != x || cy[j] != y || cz[j] != z) continue;
+                            if (reach[j] > reach[i] || (reach[j] == reach[i] && (size_t)j <= i)) continue;
+                            double ex = s.x[j] - s.x[i], ey = s.y[j] - s.y[i], ez = s.z[j] - s.z[i];
+                            double rr = dist + reach[i] + reach[j];
+                            if (ex * ex + ey * ey + ez * ez < rr * rr) f(i, (size_t)j);
+                        }
+                    }
+        }
+    }
+
+private:
+    int cellOf(double v) const { return (int)floor(v / cell); }
+    size_t slot(int x, int y, int z) const {
+        return ((unsigned)x * 73856093u ^ (unsigned)y * 19349663u ^ (unsigned)z * 83492791u) & (heads.size() - 1);
+    }
+
+    double cell = 1;
+    vector<int> heads, next, cx, cy, cz;
+};
+
+// Relative separation, g = dr . dv and dg/dt for bodies a and b at time t.
+static double approachG(const Elements& el, size_t a, size_t b, double t, double& d, double& dg) {
+    double ra[3], va[3], rb[3], vb[3];
+    stateOf(el, a, t, ra, va);
+    stateOf(el, b, t, rb, vb);
+    double dr[3], dv[3], da[3];
+    double ia = el.mm[a] * el.mm[a] * pow(el.a[a], 3) / pow(ra[0] * ra[0] + ra[1] * ra[1] + ra[2] * ra[2], 1.5);
+    double ib = el.mm[b] * el.mm[b] * pow(el.a[b], 3) / pow(rb[0] * rb[0] + rb[1] * rb[1] + rb[2] * rb[2], 1.5);
+    double g = 0, vv = 0, ra_ = 0, rr = 0;
+    for (int k = 0; k < 3; k++) {
+        dr[k] = rb[k] - ra[k];
+        dv[k] = vb[k] - va[k];
+        da[k] = ia * ra[k] - ib * rb[k];
+        g += dr[k] * dv[k];
+        vv += dv[k] * dv[k];
+        ra_ += dr[k] * da[k];
+        rr += dr[k] * dr[k];
+    }
+    d = sqrt(rr);
+    dg = vv + ra_;
+    return g;
+}
+
+// Minimum separation of a and b on (lo, hi], or false when it lies outside.
+// At the ends of the whole window (atStart/atEnd) a receding or approaching
+// pair reports the endpoint itself.
+static bool refineApproach(const Elements& el, size_t a, size_t b, double lo, double hi,
+                           bool atStart, bool atEnd, double& tMin, double& dMin) {
+    double dLo, dHi, dg;
+    double gLo = approachG(el, a, b, lo, dLo, dg), gHi = approachG(el, a, b, hi, dHi, dg);
+    if (gLo >= 0) {
+        if (!atStart) return false;
+        tMin = lo, dMin = dLo;
+        return true;
+    }
+    if (gHi < 0) {
+        if (!atEnd) return false;
+        tMin = hi, dMin = dHi;
+        return true;
+    }
+    double t = 0.5 * (lo + hi), d = 0;
+    for (int it = 0; it < 60; it++) {
+        double g = approachG(el, a, b, t, d, dg);
+        if (g < 0) lo = t;
+        else hi = t;
+        double nt = dg > 0 ? t - g / dg : lo - 1;
+        if (nt <= lo || nt >= hi) nt = 0.5 * (lo + hi);
+        if (fabs(nt - t) < 1e-10 || hi - lo < 1e-10) {
+            t = nt;
+            break;
+        }
+        t = nt;
+    }
+    approachG(el, a, b, t, d, dg);
+    tMin = t, dMin = d;
+    return true;
+}
+
+struct ScreenStats {
+    size_t steps = 0, candidates = 0;
+    double seconds = 0;
+};
+
+// All minima of pairwise separation below `dist` AU in [t0, t1] days, sorted
+// by time. Steps are handed out in slabs to `threads` workers.
+vector<Approach> screenApproaches(const Elements& el, double t0, double t1, double step, double dist,
+                                  int threads, ScreenStats& stats) {
+    auto start = chrono::steady_clock::now();
+    size_t steps = max(1.0, ceil((t1 - t0) / step));
+    step = (t1 - t0) / steps;
+    vector<double> reach(el.n);
+    for (size_t k = 0; k < el.n; k++)
+        reach[k] = el.mm[k] * el.a[k] * sqrt((1 + el.e[k]) / (1 - el.e[k])) * step / 2;
+    vector<double> sorted = reach;
+    double cut = 0;
+    if (!sorted.empty()) {
+        size_t q = sorted.size() * 99 / 100;
+        nth_element(sorted.begin(), sorted.begin() + q, sorted.end());
+        cut = sorted[q];
+    }
+    double cell = dist + 2 * cut;
+
+    const size_t slab = 8;
+    atomic<size_t> nextSlab{0}, candidates{0};
+    vector<vector<Approach>> found(max(1, threads));
+    auto work = [&](int th) {
+        States s;
+        ApproachGrid grid;
+        size_t local = 0;
+        for (size_t s0; (s0 = nextSlab.fetch_add(slab)) < steps;)
+            for (size_t k = s0; k < min(steps, s0 + slab); k++) {
+                double lo = t0 + k * step, hi = k + 1 == steps ? t1 : lo + step;
+                propagate(el, 0.5 * (lo + hi), s);
+                grid.build(s, cell);
+                grid.candidates(s, reach, dist, [&](size_t i, size_t j) {
+                    local++;
+                    double t, d;
+                    if (refineApproach(el, i, j, lo, hi, k == 0, k + 1 == steps, t, d) && d < dist)
+                        found[th].push_back({(uint32_t)min(i, j), (uint32_t)max(i, j), t, d});
+                });
+            }
+        candidates += local;
+    };
+    vector<thread> pool;
+    for (int th = 1; th < threads; th++) pool.emplace_back(work, th);
+    work(0);
+    for (auto& t : pool) t.join();
+
+    vector<Approach> out;
+    for (auto& f : found) out.insert(out.end(), f.begin(), f.end());
+    sort(out.begin(), out.end(), [](const Approach& x, const Approach& y) { return x.t < y.t; });
+    stats.steps = steps;
+    stats.candidates = candidates;
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return out;
+}
+
 void pos(Body b, double days) {
-    double mu = G * MSun;
-    double n = sqrt(mu / pow(b.a * AU, 3));
-    double M = fmod(b.m0 * M_PI / 180.0 + n * (days * 86400), 2 * M_PI);
-    
-    double E = solve(M, b.e);
-    double v = 2 * atan2(sqrt(1 + b.e) * sin(E/2), sqrt(1 - b.e) * cos(E/2));
-    double r = b.a * AU * (1 - b.e * cos(E));
-    
-    double x = r * cos(v) / AU;
-    double y = r * sin(v) / AU;
-    
-    printf("t: %.1f | r: %.4f | pos: (%.4f, %.4f)\n", days, r/AU, x, y);
-}
-
-int main() {
+    Elements el;
+    el.push(b);
+    States s;
+    propagate(el, days, s);
+    double r = sqrt(s.x[0] * s.x[0] + s.y[0] * s.y[0] + s.z[0] * s.z[0]);
+
+    printf("t: %.1f | r: %.4f | pos: (%.4f, %.4f, %.4f)\n", days, r, s.x[0], s.y[0], s.z[0] + 0.0);
+}
+
+// Random elements for the benchmarks: a in [0.5, 40] AU, e up to emax.
+Elements randomElements(size_t n, double emax, unsigned seed) {
+    mt19937_64 rng(seed);
+    uniform_real_distribution<double> ua(0.5, 40), ue(0, emax), ui(0, 180), uang(0, 360);
+    Elements el;
+    el.resize(n);
+    for (size_t k = 0; k < n; k++) el.set(k, {ua(rng), ue(rng), ui(rng), uang(rng), uang(rng), uang(rng)});
+    el.prepare(0, n);
+    return el;
+}
+
+// Random elements with eccentricities up to 0.99, propagated to `epochs`
+// epochs with the scalar and AVX2 paths.
+void bench(size_t n, int epochs) {
+    Elements el = randomElements(n, 0.99, 7);
+
+    States ref, vec;
+    double ts = 0, tv = 0, worst = 0, resid = 0;
+    size_t fallback = 0;
+    for (int ep = 0; ep < epochs; ep++) {
+        double days = 365.25 * ep * 3.7;
+        auto t0 = chrono::steady_clock::now();
+        propagate(el, days, ref, false);
+        ts += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        t0 = chrono::steady_clock::now();
+        fallback += propagate(el, days, vec, true);
+        tv += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        for (size_t k = 0; k < n; k++) {
+            double d = fabs(vec.x[k] - ref.x[k]) + fabs(vec.y[k] - ref.y[k]) + fabs(vec.z[k] - ref.z[k]);
+            worst = max(worst, d / el.a[k]);
+        }
+        for (size_t k = 0; k < n; k += 97) {
+            double m = wrapPi(el.meanAnomaly(k, days)), E = solve(m, el.e[k]);
+            resid = max(resid, fabs(E - el.e[k] * sin(E) - m));
+        }
+    }
+    double evals = (double)n * epochs;
+    printf("%zu bodies x %d epochs\n", n, epochs);
+    printf("scalar %8.2f M states/s\n", evals / ts / 1e6);
+    printf("%-6s %8.2f M states/s (%.1fx), max |dr|/a vs scalar %.1e, %zu scalar fallbacks\n",
+           hasAVX2() ? "avx2" : "scalar", evals / tv / 1e6, ts / tv, worst, fallback);
+    printf("max Kepler residual |E - e sin E - M| %.1e\n", resid);
+}
+
+// Builds an ephemeris over [el.t0, el.t0 + span] and compares dense
+// evaluation with calling the propagator at every sample time.
+void runEphemeris(const Elements& el, double span, double segDays, int degree, double tol, int threads) {
+    auto t0 = chrono::steady_clock::now();
+    Ephemeris eph = buildEphemeris(el, el.t0, span, segDays, degree, tol, threads);
+    double build = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    printf("%zu bodies, %.0f d: %zu segments of %.3f d, %d coefficients/axis, %.1f MB, built in %.3f s\n",
+           eph.bodies, span, eph.segs, eph.len, eph.degree, eph.coef.size() * 8 / 1e6, build);
+    printf("max position error vs analytic: %.2e AU (%.0f m)\n", eph.maxErr, eph.maxErr * AU);
+
+    int samples = 2000;
+    States a, b;
+    double tp = 0, te = 0, worstV = 0;
+    for (int j = 0; j < samples; j++) {
+        double t = el.t0 + span * (j + 0.5) / samples;
+        t0 = chrono::steady_clock::now();
+        propagate(el, t, a);
+        tp += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        t0 = chrono::steady_clock::now();
+        eph.evalAll(t, b);
+        te += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        for (size_t k = 0; k < el.n; k++) {
+            double dv = fabs(a.vx[k] - b.vx[k]) + fabs(a.vy[k] - b.vy[k]) + fabs(a.vz[k] - b.vz[k]);
+            double v = fabs(a.vx[k]) + fabs(a.vy[k]) + fabs(a.vz[k]);
+            worstV = max(worstV, dv / v);
+        }
+    }
+    double n = (double)samples * el.n;
+    printf("dense sampling: propagate %.2f M states/s, ephemeris %.2f M states/s (%.1fx), max rel velocity err %.1e\n",
+           n / tp / 1e6, n / te / 1e6, tp / te, worstV);
+
+    // One body sampled densely, as for plotting a track.
+    int dense = 1000000;
+    double r[3], v[3], sum = 0;
+    t0 = chrono::steady_clock::now();
+    for (int j = 0; j < dense; j++) {
+        eph.eval(0, el.t0 + span * (j + 0.5) / dense, r, v);
+        sum += r[0];
+    }
+    te = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    printf("single-body track: %.1f ns per position+velocity (checksum %.3f)\n", te / dense * 1e9, sum / dense);
+}
+
+// Screens [el.t0, el.t0 + window] for approaches closer than `dist` AU and
+// prints the closest ones.
+void runScreen(const Elements& el, double window, double step, double dist, int threads) {
+    ScreenStats st;
+    vector<Approach> hits = screenApproaches(el, el.t0, el.t0 + window, step, dist, threads, st);
+    double pairs = 0.5 * el.n * (el.n - 1.0) * st.steps;
+    printf("%zu bodies, %.0f d from t0 %.1f in %zu steps of %.3f d, %d threads: %.3f s\n", el.n, window, el.t0,
+           st.steps, window / st.steps, threads, st.seconds);
+    printf("%zu candidates refined, %zu approaches < %g AU; %.3g pairs/s screened (pair-steps)\n",
+           st.candidates, hits.size(), dist, pairs / st.seconds);
+    vector<Approach> closest = hits;
+    sort(closest.begin(), closest.end(), [](const Approach& x, const Approach& y) { return x.dist < y.dist; });
+    for (size_t k = 0; k < min<size_t>(10, closest.size()); k++)
+        printf("  %7u %7u  t=%12.4f  %.6f AU\n", closest[k].a, closest[k].b, closest[k].t, closest[k].dist);
+}
+
+// Loads a catalog (text or cache), optionally writes the cache, and
+// propagates everything to `days` past the catalog's time origin (`origin`,
+// or its latest epoch when that is 0).
+int runCatalog(const string& catalog, const string& cache, bool fromCache, int threads, double origin, double days) {
+    Elements el;
+    auto t0 = chrono::steady_clock::now();
+    bool ok = fromCache ? loadCache(catalog, el) : loadCatalog(catalog, el, threads);
+    if (!ok) return 1;
+    el.t0 = origin != 0 ? origin : referenceEpoch(el);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    struct stat st;
+    double mb = stat(catalog.c_str(), &st) == 0 ? st.st_size / 1e6 : 0;
+    printf("%s: %zu orbits in %.3f s (%.0f MB/s, %.2f M orbits/s)%s\n", catalog.c_str(), el.n, secs,
+           mb / secs, el.n / secs / 1e6, fromCache ? " from cache" : "");
+    if (!cache.empty()) {
+        if (!saveCache(cache, el)) return 1;
+        printf("wrote %s\n", cache.c_str());
+    }
+
+    States s;
+    t0 = chrono::steady_clock::now();
+    propagate(el, el.t0 + days, s);
+    secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    double rmax = 0;
+    for (size_t k = 0; k < el.n; k++) rmax = max(rmax, sqrt(s.x[k] * s.x[k] + s.y[k] * s.y[k] + s.z[k] * s.z[k]));
+    printf("propagated to t0 %.1f %+.1f d in %.3f s, max r %.3f AU\n", el.t0, days, secs, rmax);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    size_t benchN = 0;
+    int epochs = 10;
+    string catalog, cache, fromCache;
+    int threads = max(1u, thread::hardware_concurrency());
+    double days = 0, origin = 0;
+    bool ephem = false;
+    size_t ephemN = 0;
+    double span = 3652.5, segDays = 32, tol = 1e-9;
+    int degree = 12;
+    bool screen = false;
+    size_t screenN = 0;
+    double window = 365.25, step = 1, dist = 0.01;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        size_t eq = a.find('=');
+        string key = a.substr(0, eq), val = eq == string::npos ? "" : a.substr(eq + 1);
+        if (key == "--bench") benchN = stoul(val);
+        else if (key == "--epochs") epochs = stoi(val);
+        else if (key == "--catalog") catalog = val;
+        else if (key == "--save-cache") cache = val;
+        else if (key == "--cache") fromCache = val;
+        else if (key == "--threads") threads = stoi(val);
+        else if (key == "--days") days = stod(val);
+        else if (key == "--t0") origin = stod(val);
+        else if (key == "--ephem") ephem = true, ephemN = val.empty() ? 0 : stoul(val);
+        else if (key == "--span") span = stod(val);
+        else if (key == "--segment") segDays = stod(val);
+        else if (key == "--degree") degree = stoi(val);
+        else if (key == "--tol") tol = stod(val);
+        else if (key == "--screen") screen = true, screenN = val.empty() ? 0 : stoul(val);
+        else if (key == "--window") window = stod(val);
+        else if (key == "--step") step = stod(val);
+        else if (key == "--dist") dist = stod(val);
+        else {
+            fprintf(stderr, "unknown option %s\n"
+                    "usage: %s [--bench=N --epochs=K]\n"
+                    "          [--catalog=MPCORB.DAT|elements.csv [--save-cache=FILE] | --cache=FILE]\n"
+                    "          [--threads=T] [--t0=JD] [--days=D]\n"
+                    "          [--ephem[=N] [--span=DAYS] [--segment=DAYS] [--degree=K] [--tol=AU]]\n"
+                    "          [--screen[=N] [--window=DAYS] [--step=DAYS] [--dist=AU]]\n", a.c_str(), argv[0]);
+            return 1;
+        }
+    }
+    if (benchN) {
+        bench(benchN, epochs);
+        return 0;
+    }
+    // --ephem and --screen take N random bodies, or the catalog when N is
+    // omitted; a catalog is put on one time origin first.
+    if (ephem || screen) {
+        size_t n = ephem ? ephemN : screenN;
+        Elements el;
+        if (n) el = randomElements(n, 0.3, ephem ? 11 : 13);
+        else if (!catalog.empty() ? !loadCatalog(catalog, el, threads) : !loadCache(fromCache, el)) return 1;
+        el.t0 = origin != 0 ? origin : referenceEpoch(el);
+        if (ephem) runEphemeris(el, span, segDays, degree, tol, threads);
+        else runScreen(el, window, step, dist, threads);
+        return 0;
+    }
+    if (!catalog.empty()) return runCatalog(catalog, cache, false, threads, origin, days);
+    if (!fromCache.empty()) return runCatalog(fromCache, "", true, threads, origin, days);
+
     Body earth = {1.00000011, 0.01671022, 0.0, 0.0, 0.0, 100.46435};
     cout << "Earth Orbit Data:" << endl;
     for (double t = 0; t <= 270; t += 90) pos(earth, t);
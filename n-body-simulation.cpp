@@ -3,6 +3,22 @@
 #include <cmath>
 #include <random>
 #include <cstdio>
+#include <string>
+#include <cstring>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <complex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <immintrin.h>
 using namespace std;
 struct Star {
     double x, y, z;
@@ -12,6 +28,8 @@ struct Star {
 };
 const double G = 1.0;
 const double Softening = 0.1;
+
+// Reference array-of-structs kernel; the SoA kernels below are checked against it.
 void accel(vector<Star>& stars) {
     for (auto& s : stars) {
         s.ax = s.ay = s.az = 0;
@@ -37,48 +55,1742 @@ void accel(vector<Star>& stars) {
     }
 }
 
-void step(vector<Star>& stars, double dt) {
-    for (auto& s : stars) {
-        s.vx += s.ax * 0.5 * dt;
-        s.vy += s.ay * 0.5 * dt;
-        s.vz += s.az * 0.5 * dt;
-        s.x += s.vx * dt;
-        s.y += s.vy * dt;
-        s.z += s.vz * dt;
+// Structure-of-arrays particle store. All ten columns share one allocation,
+// each column starting on a 64-byte boundary. After a restart the x..vz and
+// m columns instead point into a private (copy-on-write) mapping of the
+// snapshot file, see mapSnapshot().
+struct Particles {
+    size_t n = 0, stride = 0;
+    double *x = nullptr, *y = nullptr, *z = nullptr;
+    double *vx = nullptr, *vy = nullptr, *vz = nullptr;
+    double *ax = nullptr, *ay = nullptr, *az = nullptr;
+    double *m = nullptr;
+    vector<double> store;
+    void* mapping = nullptr;
+    size_t mappingBytes = 0;
+
+    Particles() {}
+    explicit Particles(size_t count) { resize(count); }
+    Particles(const Particles& o) { *this = o; }
+    ~Particles() { unmap(); }
+    Particles& operator=(const Particles& o) {
+        if (this == &o) return *this;
+        resize(o.n);
+        for (int c = 0; c < 10; c++) copy(o.column(c), o.column(c) + n, column(c));
+        return *this;
+    }
+
+    void resize(size_t count) {
+        unmap();
+        n = count;
+        stride = (count + 7) & ~size_t(7);
+        double** cols[10] = {&x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &m};
+        double* base = allocate(10);
+        for (int c = 0; c < 10; c++) *cols[c] = base + c * stride;
+    }
+    // Take x, y, z, vx, vy, vz, m from `columns` (7 columns, `colStride`
+    // doubles apart) owned by a mapping of `bytes` bytes; only the
+    // acceleration columns are allocated.
+    void adopt(void* map, size_t bytes, double* columns, size_t count, size_t colStride) {
+        unmap();
+        n = count;
+        stride = (count + 7) & ~size_t(7);
+        double** cols[7] = {&x, &y, &z, &vx, &vy, &vz, &m};
+        for (int c = 0; c < 7; c++) *cols[c] = columns + c * colStride;
+        double* base = allocate(3);
+        ax = base; ay = base + stride; az = base + 2 * stride;
+        mapping = map;
+        mappingBytes = bytes;
+    }
+    double* column(int c) const {
+        double* const cols[10] = {x, y, z, vx, vy, vz, ax, ay, az, m};
+        return cols[c];
+    }
+
+private:
+    double* allocate(int columns) {
+        store.assign(columns * stride + 8, 0.0);
+        size_t skew = (64 - reinterpret_cast<uintptr_t>(store.data()) % 64) % 64 / sizeof(double);
+        return store.data() + skew;
+    }
+    void unmap() {
+        if (mapping) munmap(mapping, mappingBytes);
+        mapping = nullptr;
+        mappingBytes = 0;
+    }
+};
+
+enum class Kernel { Scalar, AVX2, AVX512 };
+
+const char* kernelName(Kernel k) {
+    switch (k) {
+        case Kernel::AVX512: return "avx512";
+        case Kernel::AVX2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+bool kernelSupported(Kernel k) {
+    __builtin_cpu_init();
+    if (k == Kernel::AVX512) return __builtin_cpu_supports("avx512f");
+    if (k == Kernel::AVX2) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return true;
+}
+
+Kernel detectKernel() {
+    if (kernelSupported(Kernel::AVX512)) return Kernel::AVX512;
+    if (kernelSupported(Kernel::AVX2)) return Kernel::AVX2;
+    return Kernel::Scalar;
+}
+
+// Symmetric i<j sweep over rows [r0, r1), same arithmetic as accel() but on
+// the SoA columns. Both ends of every pair are accumulated into bx/by/bz,
+// which the caller must zero.
+static void accelScalarRows(const Particles& p, size_t r0, size_t r1, double* bx, double* by, double* bz) {
+    const size_t n = p.n;
+    const double eps2 = Softening * Softening;
+    for (size_t i = r0; i < r1; i++) {
+        double xi = p.x[i], yi = p.y[i], zi = p.z[i], mi = p.m[i];
+        double axi = 0, ayi = 0, azi = 0;
+        for (size_t j = i + 1; j < n; j++) {
+            double dx = p.x[j] - xi;
+            double dy = p.y[j] - yi;
+            double dz = p.z[j] - zi;
+            double r2 = dx*dx + dy*dy + dz*dz + eps2;
+            double invR3 = G / (r2 * sqrt(r2));
+            double mj = p.m[j] * invR3, mij = mi * invR3;
+            axi += mj * dx; ayi += mj * dy; azi += mj * dz;
+            bx[j] -= mij * dx; by[j] -= mij * dy; bz[j] -= mij * dz;
+        }
+        bx[i] += axi; by[i] += ayi; bz[i] += azi;
+    }
+}
+
+void accelScalar(Particles& p) {
+    fill(p.ax, p.ax + p.n, 0.0);
+    fill(p.ay, p.ay + p.n, 0.0);
+    fill(p.az, p.az + p.n, 0.0);
+    accelScalarRows(p, 0, p.n, p.ax, p.ay, p.az);
+}
+
+// Where a force pass reads sink positions and writes accelerations: normally
+// the particle columns themselves, or a gathered subset of them.
+struct Sinks {
+    const double *x, *y, *z;
+    double *ax, *ay, *az;
+};
+
+Sinks sinksOf(Particles& p) { return {p.x, p.y, p.z, p.ax, p.ay, p.az}; }
+
+// Unscaled (no G) softened sum for a sink at (xi, yi, zi) over sources [j0, j1).
+static void sumDirect(const Particles& p, double xi, double yi, double zi, size_t j0, size_t j1,
+                      double& axi, double& ayi, double& azi) {
+    const double eps2 = Softening * Softening;
+    for (size_t j = j0; j < j1; j++) {
+        double dx = p.x[j] - xi;
+        double dy = p.y[j] - yi;
+        double dz = p.z[j] - zi;
+        double r2 = dx*dx + dy*dy + dz*dz + eps2;
+        double s = p.m[j] / (r2 * sqrt(r2));
+        axi += s * dx; ayi += s * dy; azi += s * dz;
+    }
+}
+
+// Tail sinks that do not fill a SIMD register.
+static void accelTail(const Particles& p, Sinks s, size_t i, size_t j0, size_t j1) {
+    double axi = 0, ayi = 0, azi = 0;
+    sumDirect(p, s.x[i], s.y[i], s.z[i], j0, j1, axi, ayi, azi);
+    s.ax[i] += G * axi; s.ay[i] += G * ayi; s.az[i] += G * azi;
+}
+
+// The SIMD kernels drop Newton's third law and vectorize over the sinks
+// [i0, i1): a block of sinks stays in registers while one source at a time is
+// broadcast. The source loop is tiled so a tile of x/y/z/m (JTile * 32 bytes)
+// stays in L1 while every sink block sweeps it. The self term is harmless:
+// dx = 0. Sinks are only written by their own range, so disjoint ranges can
+// run on different threads.
+const size_t JTile = 512;
+
+__attribute__((target("avx2,fma")))
+static void accelAVX2(const Particles& p, Sinks s, size_t i0, size_t i1) {
+    const size_t n = p.n, nv = i0 + ((i1 - i0) & ~size_t(7));
+    const __m256d eps2 = _mm256_set1_pd(Softening * Softening);
+    const __m256d g = _mm256_set1_pd(G);
+    fill(s.ax + i0, s.ax + i1, 0.0);
+    fill(s.ay + i0, s.ay + i1, 0.0);
+    fill(s.az + i0, s.az + i1, 0.0);
+    for (size_t j0 = 0; j0 < n; j0 += JTile) {
+        size_t j1 = min(n, j0 + JTile);
+        for (size_t i = i0; i < nv; i += 8) {
+            __m256d xa = _mm256_loadu_pd(s.x + i), xb = _mm256_loadu_pd(s.x + i + 4);
+            __m256d ya = _mm256_loadu_pd(s.y + i), yb = _mm256_loadu_pd(s.y + i + 4);
+            __m256d za = _mm256_loadu_pd(s.z + i), zb = _mm256_loadu_pd(s.z + i + 4);
+            __m256d axa = _mm256_setzero_pd(), axb = _mm256_setzero_pd();
+            __m256d aya = _mm256_setzero_pd(), ayb = _mm256_setzero_pd();
+            __m256d aza = _mm256_setzero_pd(), azb = _mm256_setzero_pd();
+            for (size_t j = j0; j < j1; j++) {
+                __m256d xj = _mm256_broadcast_sd(p.x + j);
+                __m256d yj = _mm256_broadcast_sd(p.y + j);
+                __m256d zj = _mm256_broadcast_sd(p.z + j);
+                __m256d mj = _mm256_broadcast_sd(p.m + j);
+                __m256d dxa = _mm256_sub_pd(xj, xa), dxb = _mm256_sub_pd(xj, xb);
+                __m256d dya = _mm256_sub_pd(yj, ya), dyb = _mm256_sub_pd(yj, yb);
+                __m256d dza = _mm256_sub_pd(zj, za), dzb = _mm256_sub_pd(zj, zb);
+                __m256d ra = _mm256_fmadd_pd(dxa, dxa, eps2), rb = _mm256_fmadd_pd(dxb, dxb, eps2);
+                ra = _mm256_fmadd_pd(dya, dya, ra); rb = _mm256_fmadd_pd(dyb, dyb, rb);
+                ra = _mm256_fmadd_pd(dza, dza, ra); rb = _mm256_fmadd_pd(dzb, dzb, rb);
+                __m256d sa = _mm256_div_pd(mj, _mm256_mul_pd(ra, _mm256_sqrt_pd(ra)));
+                __m256d sb = _mm256_div_pd(mj, _mm256_mul_pd(rb, _mm256_sqrt_pd(rb)));
+                axa = _mm256_fmadd_pd(sa, dxa, axa); axb = _mm256_fmadd_pd(sb, dxb, axb);
+                aya = _mm256_fmadd_pd(sa, dya, aya); ayb = _mm256_fmadd_pd(sb, dyb, ayb);
+                aza = _mm256_fmadd_pd(sa, dza, aza); azb = _mm256_fmadd_pd(sb, dzb, azb);
+            }
+            _mm256_storeu_pd(s.ax + i, _mm256_fmadd_pd(g, axa, _mm256_loadu_pd(s.ax + i)));
+            _mm256_storeu_pd(s.ax + i + 4, _mm256_fmadd_pd(g, axb, _mm256_loadu_pd(s.ax + i + 4)));
+            _mm256_storeu_pd(s.ay + i, _mm256_fmadd_pd(g, aya, _mm256_loadu_pd(s.ay + i)));
+            _mm256_storeu_pd(s.ay + i + 4, _mm256_fmadd_pd(g, ayb, _mm256_loadu_pd(s.ay + i + 4)));
+            _mm256_storeu_pd(s.az + i, _mm256_fmadd_pd(g, aza, _mm256_loadu_pd(s.az + i)));
+            _mm256_storeu_pd(s.az + i + 4, _mm256_fmadd_pd(g, azb, _mm256_loadu_pd(s.az + i + 4)));
+        }
+        for (size_t i = nv; i < i1; i++) accelTail(p, s, i, j0, j1);
+    }
+}
+
+// AVX-512 has no cheap double sqrt/div, so 1/sqrt(r2) comes from the 14-bit
+// rsqrt estimate plus two Newton steps (good to ~1e-16 relative).
+__attribute__((target("avx512f")))
+static void accelAVX512(const Particles& p, Sinks s, size_t i0, size_t i1) {
+    const size_t n = p.n, nv = i0 + ((i1 - i0) & ~size_t(15));
+    const __m512d eps2 = _mm512_set1_pd(Softening * Softening);
+    const __m512d half = _mm512_set1_pd(0.5), threeHalves = _mm512_set1_pd(1.5);
+    const __m512d g = _mm512_set1_pd(G);
+    fill(s.ax + i0, s.ax + i1, 0.0);
+    fill(s.ay + i0, s.ay + i1, 0.0);
+    fill(s.az + i0, s.az + i1, 0.0);
+    for (size_t j0 = 0; j0 < n; j0 += JTile) {
+        size_t j1 = min(n, j0 + JTile);
+        for (size_t i = i0; i < nv; i += 16) {
+            __m512d xa = _mm512_loadu_pd(s.x + i), xb = _mm512_loadu_pd(s.x + i + 8);
+            __m512d ya = _mm512_loadu_pd(s.y + i), yb = _mm512_loadu_pd(s.y + i + 8);
+            __m512d za = _mm512_loadu_pd(s.z + i), zb = _mm512_loadu_pd(s.z + i + 8);
+            __m512d axa = _mm512_setzero_pd(), axb = _mm512_setzero_pd();
+            __m512d aya = _mm512_setzero_pd(), ayb = _mm512_setzero_pd();
+            __m512d aza = _mm512_setzero_pd(), azb = _mm512_setzero_pd();
+            for (size_t j = j0; j < j1; j++) {
+                __m512d xj = _mm512_set1_pd(p.x[j]);
+                __m512d yj = _mm512_set1_pd(p.y[j]);
+                __m512d zj = _mm512_set1_pd(p.z[j]);
+                __m512d mj = _mm512_set1_pd(p.m[j]);
+                __m512d dxa = _mm512_sub_pd(xj, xa), dxb = _mm512_sub_pd(xj, xb);
+                __m512d dya = _mm512_sub_pd(yj, ya), dyb = _mm512_sub_pd(yj, yb);
+                __m512d dza = _mm512_sub_pd(zj, za), dzb = _mm512_sub_pd(zj, zb);
+                __m512d ra = _mm512_fmadd_pd(dxa, dxa, eps2), rb = _mm512_fmadd_pd(dxb, dxb, eps2);
+                ra = _mm512_fmadd_pd(dya, dya, ra); rb = _mm512_fmadd_pd(dyb, dyb, rb);
+                ra = _mm512_fmadd_pd(dza, dza, ra); rb = _mm512_fmadd_pd(dzb, dzb, rb);
+                __m512d ya0 = _mm512_rsqrt14_pd(ra), yb0 = _mm512_rsqrt14_pd(rb);
+                __m512d ha = _mm512_mul_pd(half, ra), hb = _mm512_mul_pd(half, rb);
+                ya0 = _mm512_mul_pd(ya0, _mm512_fnmadd_pd(ha, _mm512_mul_pd(ya0, ya0), threeHalves));
+                yb0 = _mm512_mul_pd(yb0, _mm512_fnmadd_pd(hb, _mm512_mul_pd(yb0, yb0), threeHalves));
+                ya0 = _mm512_mul_pd(ya0, _mm512_fnmadd_pd(ha, _mm512_mul_pd(ya0, ya0), threeHalves));
+                yb0 = _mm512_mul_pd(yb0, _mm512_fnmadd_pd(hb, _mm512_mul_pd(yb0, yb0), threeHalves));
+                __m512d sa = _mm512_mul_pd(mj, _mm512_mul_pd(ya0, _mm512_mul_pd(ya0, ya0)));
+                __m512d sb = _mm512_mul_pd(mj, _mm512_mul_pd(yb0, _mm512_mul_pd(yb0, yb0)));
+                axa = _mm512_fmadd_pd(sa, dxa, axa); axb = _mm512_fmadd_pd(sb, dxb, axb);
+                aya = _mm512_fmadd_pd(sa, dya, aya); ayb = _mm512_fmadd_pd(sb, dyb, ayb);
+                aza = _mm512_fmadd_pd(sa, dza, aza); azb = _mm512_fmadd_pd(sb, dzb, azb);
+            }
+            _mm512_storeu_pd(s.ax + i, _mm512_fmadd_pd(g, axa, _mm512_loadu_pd(s.ax + i)));
+            _mm512_storeu_pd(s.ax + i + 8, _mm512_fmadd_pd(g, axb, _mm512_loadu_pd(s.ax + i + 8)));
+            _mm512_storeu_pd(s.ay + i, _mm512_fmadd_pd(g, aya, _mm512_loadu_pd(s.ay + i)));
+            _mm512_storeu_pd(s.ay + i + 8, _mm512_fmadd_pd(g, ayb, _mm512_loadu_pd(s.ay + i + 8)));
+            _mm512_storeu_pd(s.az + i, _mm512_fmadd_pd(g, aza, _mm512_loadu_pd(s.az + i)));
+            _mm512_storeu_pd(s.az + i + 8, _mm512_fmadd_pd(g, azb, _mm512_loadu_pd(s.az + i + 8)));
+        }
+        for (size_t i = nv; i < i1; i++) accelTail(p, s, i, j0, j1);
+    }
+}
+
+void accel(Particles& p, Kernel k) {
+    switch (k) {
+        case Kernel::AVX512: accelAVX512(p, sinksOf(p), 0, p.n); break;
+        case Kernel::AVX2: accelAVX2(p, sinksOf(p), 0, p.n); break;
+        default: accelScalar(p); break;
+    }
+}
+
+// Fixed-size pool; run(job) calls job(t) once for every t in [0, size()),
+// t = 0 on the calling thread, and returns when all of them are done. Work
+// is split statically by t, so results do not depend on scheduling.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads) : count(max(1, threads)) {
+        for (int t = 1; t < count; t++) workers.emplace_back([this, t] { loop(t); });
+    }
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lk(mu);
+            quit = true;
+        }
+        wake.notify_all();
+        for (auto& w : workers) w.join();
+    }
+    int size() const { return count; }
+
+    void run(const function<void(int)>& job) {
+        if (count == 1) { job(0); return; }
+        {
+            lock_guard<mutex> lk(mu);
+            task = &job;
+            pending = count - 1;
+            generation++;
+        }
+        wake.notify_all();
+        job(0);
+        unique_lock<mutex> lk(mu);
+        done.wait(lk, [&] { return pending == 0; });
+    }
+
+private:
+    void loop(int t) {
+        uint64_t seen = 0;
+        for (;;) {
+            const function<void(int)>* job;
+            {
+                unique_lock<mutex> lk(mu);
+                wake.wait(lk, [&] { return quit || generation != seen; });
+                if (quit) return;
+                seen = generation;
+                job = task;
+            }
+            (*job)(t);
+            lock_guard<mutex> lk(mu);
+            if (--pending == 0) done.notify_one();
+        }
+    }
+
+    int count;
+    vector<thread> workers;
+    mutex mu;
+    condition_variable wake, done;
+    const function<void(int)>* task = nullptr;
+    uint64_t generation = 0;
+    int pending = 0;
+    bool quit = false;
+};
+
+// Per-thread accumulation buffers for the symmetric scalar sweep.
+struct ForceBuffers {
+    vector<double> acc;
+};
+
+// Thread t owns rows [r_t, r_t+1) of the i<j triangle, with the boundaries
+// chosen so every thread gets about the same number of pairs, and writes
+// both ends of its pairs into its own buffer. The buffers are then summed
+// per particle in thread order, so a fixed thread count is bit-reproducible.
+static void accelScalarParallel(Particles& p, ThreadPool& pool, ForceBuffers& fb) {
+    const size_t n = p.n, T = pool.size();
+    fb.acc.assign(3 * n * T, 0.0);
+    pool.run([&](int t) {
+        size_t r0 = size_t(n * (1 - sqrt(1 - double(t) / T)));
+        size_t r1 = t + 1 == int(T) ? n : size_t(n * (1 - sqrt(1 - double(t + 1) / T)));
+        double* b = fb.acc.data() + 3 * n * t;
+        accelScalarRows(p, r0, r1, b, b + n, b + 2 * n);
+    });
+    pool.run([&](int t) {
+        size_t i0 = n * t / T, i1 = n * (t + 1) / T;
+        for (size_t i = i0; i < i1; i++) {
+            double sx = 0, sy = 0, sz = 0;
+            for (size_t k = 0; k < T; k++) {
+                const double* b = fb.acc.data() + 3 * n * k;
+                sx += b[i]; sy += b[n + i]; sz += b[2 * n + i];
+            }
+            p.ax[i] = sx; p.ay[i] = sy; p.az[i] = sz;
+        }
+    });
+}
+
+// Sink range of thread t, rounded to whole 32-sink SIMD blocks.
+static void sinkRange(size_t n, int t, int T, size_t& i0, size_t& i1) {
+    size_t blocks = (n + 31) / 32;
+    i0 = min(n, blocks * t / T * 32);
+    i1 = min(n, blocks * (t + 1) / T * 32);
+}
+
+// Non-symmetric pass for `count` sinks against every particle in p, split
+// across the pool. Used for the SIMD kernels and for partial (active-only)
+// force updates.
+void accelSinks(const Particles& p, Sinks s, size_t count, Kernel k, ThreadPool& pool) {
+    pool.run([&](int t) {
+        size_t i0, i1;
+        sinkRange(count, t, pool.size(), i0, i1);
+        if (i0 == i1) return;
+        if (k == Kernel::AVX512) accelAVX512(p, s, i0, i1);
+        else if (k == Kernel::AVX2) accelAVX2(p, s, i0, i1);
+        else {
+            for (size_t i = i0; i < i1; i++) {
+                s.ax[i] = s.ay[i] = s.az[i] = 0;
+                accelTail(p, s, i, 0, p.n);
+            }
+        }
+    });
+}
+
+void accel(Particles& p, Kernel k, ThreadPool& pool, ForceBuffers& fb) {
+    if (pool.size() == 1) accel(p, k);
+    else if (k == Kernel::Scalar) accelScalarParallel(p, pool, fb);
+    else accelSinks(p, sinksOf(p), p.n, k, pool);
+}
+
+// Mixed precision: pair interactions in float, state and per-particle
+// accumulators in double. Positions are shifted to the mean position and
+// rounded to float once per evaluation, so the inner loops are pure float
+// at twice the SIMD width. Partial sums are kept in float only across one
+// source tile (JTile) and then added into the double accelerations.
+struct MixedBuffers {
+    vector<float> x, y, z, m;   // sources
+    vector<float> sx, sy, sz;   // sinks, same origin
+};
+
+static void prepareMixed(const Particles& p, Sinks s, size_t count, MixedBuffers& mb) {
+    double o[3] = {0, 0, 0};
+    for (size_t i = 0; i < p.n; i++) { o[0] += p.x[i]; o[1] += p.y[i]; o[2] += p.z[i]; }
+    for (double& v : o) v /= max<size_t>(p.n, 1);
+    for (auto* v : {&mb.x, &mb.y, &mb.z, &mb.m}) v->resize(p.n);
+    for (auto* v : {&mb.sx, &mb.sy, &mb.sz}) v->resize(count);
+    for (size_t i = 0; i < p.n; i++) {
+        mb.x[i] = float(p.x[i] - o[0]); mb.y[i] = float(p.y[i] - o[1]); mb.z[i] = float(p.z[i] - o[2]);
+        mb.m[i] = float(p.m[i]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        mb.sx[i] = float(s.x[i] - o[0]); mb.sy[i] = float(s.y[i] - o[1]); mb.sz[i] = float(s.z[i] - o[2]);
+    }
+}
+
+static void mixedOne(const MixedBuffers& mb, Sinks s, size_t i) {
+    const float eps2 = float(Softening * Softening);
+    const size_t n = mb.x.size();
+    const float xi = mb.sx[i], yi = mb.sy[i], zi = mb.sz[i];
+    double ax = 0, ay = 0, az = 0;
+    for (size_t j0 = 0; j0 < n; j0 += JTile) {
+        float fx = 0, fy = 0, fz = 0;
+        for (size_t j = j0; j < min(n, j0 + JTile); j++) {
+            float dx = mb.x[j] - xi, dy = mb.y[j] - yi, dz = mb.z[j] - zi;
+            float r2 = dx*dx + dy*dy + dz*dz + eps2;
+            float inv = 1.0f / sqrtf(r2);
+            float sc = mb.m[j] * inv * inv * inv;
+            fx += sc * dx; fy += sc * dy; fz += sc * dz;
+        }
+        ax += fx; ay += fy; az += fz;
+    }
+    s.ax[i] = G * ax; s.ay[i] = G * ay; s.az[i] = G * az;
+}
+
+// 16 sinks per block; rsqrt estimate (12 bits) plus one Newton step.
+__attribute__((target("avx2,fma")))
+static void mixedAVX2(const MixedBuffers& mb, Sinks s, size_t i0, size_t i1) {
+    const size_t n = mb.x.size(), nv = i0 + ((i1 - i0) & ~size_t(15));
+    const __m256 eps2 = _mm256_set1_ps(float(Softening * Softening));
+    const __m256 half = _mm256_set1_ps(0.5f), threeHalves = _mm256_set1_ps(1.5f);
+    alignas(32) float part[3][16];
+    fill(s.ax + i0, s.ax + nv, 0.0);
+    fill(s.ay + i0, s.ay + nv, 0.0);
+    fill(s.az + i0, s.az + nv, 0.0);
+    for (size_t j0 = 0; j0 < n; j0 += JTile) {
+        size_t j1 = min(n, j0 + JTile);
+        for (size_t i = i0; i < nv; i += 16) {
+            __m256 xa = _mm256_loadu_ps(&mb.sx[i]), xb = _mm256_loadu_ps(&mb.sx[i + 8]);
+            __m256 ya = _mm256_loadu_ps(&mb.sy[i]), yb = _mm256_loadu_ps(&mb.sy[i + 8]);
+            __m256 za = _mm256_loadu_ps(&mb.sz[i]), zb = _mm256_loadu_ps(&mb.sz[i + 8]);
+            __m256 axa = _mm256_setzero_ps(), axb = _mm256_setzero_ps();
+            __m256 aya = _mm256_setzero_ps(), ayb = _mm256_setzero_ps();
+            __m256 aza = _mm256_setzero_ps(), azb = _mm256_setzero_ps();
+            for (size_t j = j0; j < j1; j++) {
+                __m256 xj = _mm256_broadcast_ss(&mb.x[j]);
+                __m256 yj = _mm256_broadcast_ss(&mb.y[j]);
+                __m256 zj = _mm256_broadcast_ss(&mb.z[j]);
+                __m256 mj = _mm256_broadcast_ss(&mb.m[j]);
+                __m256 dxa = _mm256_sub_ps(xj, xa), dxb = _mm256_sub_ps(xj, xb);
+                __m256 dya = _mm256_sub_ps(yj, ya), dyb = _mm256_sub_ps(yj, yb);
+                __m256 dza = _mm256_sub_ps(zj, za), dzb = _mm256_sub_ps(zj, zb);
+                __m256 ra = _mm256_fmadd_ps(dxa, dxa, eps2), rb = _mm256_fmadd_ps(dxb, dxb, eps2);
+                ra = _mm256_fmadd_ps(dya, dya, ra); rb = _mm256_fmadd_ps(dyb, dyb, rb);
+                ra = _mm256_fmadd_ps(dza, dza, ra); rb = _mm256_fmadd_ps(dzb, dzb, rb);
+                __m256 ia = _mm256_rsqrt_ps(ra), ib = _mm256_rsqrt_ps(rb);
+                ia = _mm256_mul_ps(ia, _mm256_fnmadd_ps(_mm256_mul_ps(half, ra), _mm256_mul_ps(ia, ia), threeHalves));
+                ib = _mm256_mul_ps(ib, _mm256_fnmadd_ps(_mm256_mul_ps(half, rb), _mm256_mul_ps(ib, ib), threeHalves));
+                __m256 sa = _mm256_mul_ps(mj, _mm256_mul_ps(ia, _mm256_mul_ps(ia, ia)));
+                __m256 sb = _mm256_mul_ps(mj, _mm256_mul_ps(ib, _mm256_mul_ps(ib, ib)));
+                axa = _mm256_fmadd_ps(sa, dxa, axa); axb = _mm256_fmadd_ps(sb, dxb, axb);
+                aya = _mm256_fmadd_ps(sa, dya, aya); ayb = _mm256_fmadd_ps(sb, dyb, ayb);
+                aza = _mm256_fmadd_ps(sa, dza, aza); azb = _mm256_fmadd_ps(sb, dzb, azb);
+            }
+            _mm256_store_ps(part[0], axa); _mm256_store_ps(part[0] + 8, axb);
+            _mm256_store_ps(part[1], aya); _mm256_store_ps(part[1] + 8, ayb);
+            _mm256_store_ps(part[2], aza); _mm256_store_ps(part[2] + 8, azb);
+            for (int l = 0; l < 16; l++) {
+                s.ax[i + l] += G * part[0][l]; s.ay[i + l] += G * part[1][l]; s.az[i + l] += G * part[2][l];
+            }
+        }
+    }
+    for (size_t i = nv; i < i1; i++) mixedOne(mb, s, i);
+}
+
+// 32 sinks per block; rsqrt14 plus one Newton step.
+__attribute__((target("avx512f")))
+static void mixedAVX512(const MixedBuffers& mb, Sinks s, size_t i0, size_t i1) {
+    const size_t n = mb.x.size(), nv = i0 + ((i1 - i0) & ~size_t(31));
+    const __m512 eps2 = _mm512_set1_ps(float(Softening * Softening));
+    const __m512 half = _mm512_set1_ps(0.5f), threeHalves = _mm512_set1_ps(1.5f);
+    alignas(64) float part[3][32];
+    fill(s.ax + i0, s.ax + nv, 0.0);
+    fill(s.ay + i0, s.ay + nv, 0.0);
+    fill(s.az + i0, s.az + nv, 0.0);
+    for (size_t j0 = 0; j0 < n; j0 += JTile) {
+        size_t j1 = min(n, j0 + JTile);
+        for (size_t i = i0; i < nv; i += 32) {
+            __m512 xa = _mm512_loadu_ps(&mb.sx[i]), xb = _mm512_loadu_ps(&mb.sx[i + 16]);
+            __m512 ya = _mm512_loadu_ps(&mb.sy[i]), yb = _mm512_loadu_ps(&mb.sy[i + 16]);
+            __m512 za = _mm512_loadu_ps(&mb.sz[i]), zb = _mm512_loadu_ps(&mb.sz[i + 16]);
+            __m512 axa = _mm512_setzero_ps(), axb = _mm512_setzero_ps();
+            __m512 aya = _mm512_setzero_ps(), ayb = _mm512_setzero_ps();
+            __m512 aza = _mm512_setzero_ps(), azb = _mm512_setzero_ps();
+            for (size_t j = j0; j < j1; j++) {
+                __m512 xj = _mm512_set1_ps(mb.x[j]);
+                __m512 yj = _mm512_set1_ps(mb.y[j]);
+                __m512 zj = _mm512_set1_ps(mb.z[j]);
+                __m512 mj = _mm512_set1_ps(mb.m[j]);
+                __m512 dxa = _mm512_sub_ps(xj, xa), dxb = _mm512_sub_ps(xj, xb);
+                __m512 dya = _mm512_sub_ps(yj, ya), dyb = _mm512_sub_ps(yj, yb);
+                __m512 dza = _mm512_sub_ps(zj, za), dzb = _mm512_sub_ps(zj, zb);
+                __m512 ra = _mm512_fmadd_ps(dxa, dxa, eps2), rb = _mm512_fmadd_ps(dxb, dxb, eps2);
+                ra = _mm512_fmadd_ps(dya, dya, ra); rb = _mm512_fmadd_ps(dyb, dyb, rb);
+                ra = _mm512_fmadd_ps(dza, dza, ra); rb = _mm512_fmadd_ps(dzb, dzb, rb);
+                __m512 ia = _mm512_rsqrt14_ps(ra), ib = _mm512_rsqrt14_ps(rb);
+                ia = _mm512_mul_ps(ia, _mm512_fnmadd_ps(_mm512_mul_ps(half, ra), _mm512_mul_ps(ia, ia), threeHalves));
+                ib = _mm512_mul_ps(ib, _mm512_fnmadd_ps(_mm512_mul_ps(half, rb), _mm512_mul_ps(ib, ib), threeHalves));
+                __m512 sa = _mm512_mul_ps(mj, _mm512_mul_ps(ia, _mm512_mul_ps(ia, ia)));
+                __m512 sb = _mm512_mul_ps(mj, _mm512_mul_ps(ib, _mm512_mul_ps(ib, ib)));
+                axa = _mm512_fmadd_ps(sa, dxa, axa); axb = _mm512_fmadd_ps(sb, dxb, axb);
+                aya = _mm512_fmadd_ps(sa, dya, aya); ayb = _mm512_fmadd_ps(sb, dyb, ayb);
+                aza = _mm512_fmadd_ps(sa, dza, aza); azb = _mm512_fmadd_ps(sb, dzb, azb);
+            }
+            _mm512_store_ps(part[0], axa); _mm512_store_ps(part[0] + 16, axb);
+            _mm512_store_ps(part[1], aya); _mm512_store_ps(part[1] + 16, ayb);
+            _mm512_store_ps(part[2], aza); _mm512_store_ps(part[2] + 16, azb);
+            for (int l = 0; l < 32; l++) {
+                s.ax[i + l] += G * part[0][l]; s.ay[i + l] += G * part[1][l]; s.az[i + l] += G * part[2][l];
+            }
+        }
+    }
+    for (size_t i = nv; i < i1; i++) mixedOne(mb, s, i);
+}
+
+void accelMixed(const Particles& p, Sinks s, size_t count, Kernel k, ThreadPool& pool, MixedBuffers& mb) {
+    prepareMixed(p, s, count, mb);
+    pool.run([&](int t) {
+        size_t i0, i1;
+        sinkRange(count, t, pool.size(), i0, i1);
+        if (i0 == i1) return;
+        if (k == Kernel::AVX512) mixedAVX512(mb, s, i0, i1);
+        else if (k == Kernel::AVX2) mixedAVX2(mb, s, i0, i1);
+        else for (size_t i = i0; i < i1; i++) mixedOne(mb, s, i);
+    });
+}
+
+// Barnes-Hut octree. Particles are reordered along a Morton (Z-order) curve
+// before every build, so each node owns a contiguous range [begin, end) of
+// the particle columns and siblings are stored next to each other.
+struct Node {
+    double cx, cy, cz, mass;     // center of mass
+    double ox, oy, oz, size;     // lower corner and edge length of the cell
+    uint32_t begin, end;         // particle range in Morton order
+    uint32_t child, nChild;      // children are nodes[child .. child + nChild)
+};
+
+struct Octree {
+    vector<Node> nodes;
+    vector<pair<uint64_t, uint32_t>> keys;
+    vector<double> tmp;
+    int leafSize = 8;
+};
+
+const int MortonBits = 21;
+
+static uint64_t spread3(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffULL;
+    v = (v | v << 16) & 0x1f0000ff0000ffULL;
+    v = (v | v << 8) & 0x100f00f00f00f00fULL;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+    v = (v | v << 2) & 0x1249249249249249ULL;
+    return v;
+}
+
+static void mortonSort(Particles& p, Octree& t, double& ox, double& oy, double& oz, double& size) {
+    if (p.n == 0) {
+        ox = oy = oz = 0;
+        size = 1;
+        t.keys.clear();
+        return;
+    }
+    double lo[3] = {p.x[0], p.y[0], p.z[0]}, hi[3] = {lo[0], lo[1], lo[2]};
+    for (size_t i = 0; i < p.n; i++) {
+        lo[0] = min(lo[0], p.x[i]); hi[0] = max(hi[0], p.x[i]);
+        lo[1] = min(lo[1], p.y[i]); hi[1] = max(hi[1], p.y[i]);
+        lo[2] = min(lo[2], p.z[i]); hi[2] = max(hi[2], p.z[i]);
+    }
+    size = max({hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2], 1e-12}) * (1 + 1e-9);
+    ox = lo[0]; oy = lo[1]; oz = lo[2];
+    const double scale = (1 << MortonBits) / size;
+    const uint64_t qmax = (1 << MortonBits) - 1;
+    t.keys.resize(p.n);
+    for (size_t i = 0; i < p.n; i++) {
+        uint64_t qx = min(qmax, uint64_t((p.x[i] - ox) * scale));
+        uint64_t qy = min(qmax, uint64_t((p.y[i] - oy) * scale));
+        uint64_t qz = min(qmax, uint64_t((p.z[i] - oz) * scale));
+        t.keys[i] = {spread3(qx) << 2 | spread3(qy) << 1 | spread3(qz), uint32_t(i)};
+    }
+    sort(t.keys.begin(), t.keys.end());
+    t.tmp.resize(p.n);
+    for (double* col : {p.x, p.y, p.z, p.vx, p.vy, p.vz, p.m}) {
+        for (size_t i = 0; i < p.n; i++) t.tmp[i] = col[t.keys[i].second];
+        copy(t.tmp.begin(), t.tmp.end(), col);
+    }
+}
+
+static void buildNode(const Particles& p, Octree& t, uint32_t idx, int level) {
+    Node nd = t.nodes[idx];
+    if (nd.end - nd.begin <= uint32_t(t.leafSize) || level == MortonBits) {
+        double m = 0, cx = 0, cy = 0, cz = 0;
+        for (uint32_t i = nd.begin; i < nd.end; i++) {
+            m += p.m[i]; cx += p.m[i] * p.x[i]; cy += p.m[i] * p.y[i]; cz += p.m[i] * p.z[i];
+        }
+        Node& leaf = t.nodes[idx];
+        leaf.mass = m;
+        leaf.cx = m > 0 ? cx / m : nd.ox + nd.size / 2;
+        leaf.cy = m > 0 ? cy / m : nd.oy + nd.size / 2;
+        leaf.cz = m > 0 ? cz / m : nd.oz + nd.size / 2;
+        return;
+    }
+    const int shift = 3 * (MortonBits - 1 - level);
+    const double half = nd.size / 2;
+    uint32_t first = uint32_t(t.nodes.size()), count = 0;
+    uint32_t b = nd.begin;
+    while (b < nd.end) {
+        uint64_t digit = (t.keys[b].first >> shift) & 7;
+        uint32_t e = b + 1;
+        while (e < nd.end && ((t.keys[e].first >> shift) & 7) == digit) e++;
+        Node c = {};
+        c.ox = nd.ox + ((digit >> 2) & 1) * half;
+        c.oy = nd.oy + ((digit >> 1) & 1) * half;
+        c.oz = nd.oz + (digit & 1) * half;
+        c.size = half;
+        c.begin = b; c.end = e;
+        t.nodes.push_back(c);
+        count++;
+        b = e;
+    }
+    t.nodes[idx].child = first;
+    t.nodes[idx].nChild = count;
+    double m = 0, cx = 0, cy = 0, cz = 0;
+    for (uint32_t c = first; c < first + count; c++) {
+        buildNode(p, t, c, level + 1);
+        const Node& ch = t.nodes[c];
+        m += ch.mass; cx += ch.mass * ch.cx; cy += ch.mass * ch.cy; cz += ch.mass * ch.cz;
+    }
+    Node& self = t.nodes[idx];
+    self.mass = m;
+    self.cx = m > 0 ? cx / m : nd.ox + half;
+    self.cy = m > 0 ? cy / m : nd.oy + half;
+    self.cz = m > 0 ? cz / m : nd.oz + half;
+}
+
+void buildTree(Particles& p, Octree& t) {
+    Node root = {};
+    mortonSort(p, t, root.ox, root.oy, root.oz, root.size);
+    root.begin = 0;
+    root.end = uint32_t(p.n);
+    t.nodes.clear();
+    t.nodes.push_back(root);
+    buildNode(p, t, 0, 0);
+}
+
+// Walk the tree for sink i. A cell is used as a softened monopole when
+// size < theta * d (d = distance to its center of mass) and the sink lies
+// outside it; otherwise it is opened. Leaves are summed directly.
+void treeForce(const Particles& p, const Octree& t, double theta, size_t i,
+               double& axi, double& ayi, double& azi) {
+    const double eps2 = Softening * Softening, theta2 = theta * theta;
+    const double xi = p.x[i], yi = p.y[i], zi = p.z[i];
+    uint32_t stack[8 * MortonBits + 8];
+    int top = 0;
+    stack[top++] = 0;
+    axi = ayi = azi = 0;
+    while (top > 0) {
+        const Node& nd = t.nodes[stack[--top]];
+        double dx = nd.cx - xi, dy = nd.cy - yi, dz = nd.cz - zi;
+        double d2 = dx*dx + dy*dy + dz*dz;
+        bool inside = xi >= nd.ox && xi <= nd.ox + nd.size && yi >= nd.oy && yi <= nd.oy + nd.size &&
+                      zi >= nd.oz && zi <= nd.oz + nd.size;
+        if (!inside && nd.size * nd.size < theta2 * d2) {
+            double r2 = d2 + eps2;
+            double s = nd.mass / (r2 * sqrt(r2));
+            axi += s * dx; ayi += s * dy; azi += s * dz;
+        } else if (nd.nChild == 0) {
+            sumDirect(p, xi, yi, zi, nd.begin, nd.end, axi, ayi, azi);
+        } else {
+            for (uint32_t c = 0; c < nd.nChild; c++) stack[top++] = nd.child + c;
+        }
+    }
+    axi *= G; ayi *= G; azi *= G;
+}
+
+// The build is serial; walks only read the tree, so sinks are split into
+// contiguous (Morton-ordered, hence spatially coherent) slices per thread.
+void accelTree(Particles& p, Octree& t, double theta, ThreadPool& pool) {
+    buildTree(p, t);
+    pool.run([&](int th) {
+        size_t i0 = p.n * th / pool.size(), i1 = p.n * (th + 1) / pool.size();
+        for (size_t i = i0; i < i1; i++) treeForce(p, t, theta, i, p.ax[i], p.ay[i], p.az[i]);
+    });
+}
+
+// Particle-mesh gravity with open (isolated) boundaries. Masses are
+// cloud-in-cell assigned to a grid^3 mesh. The mesh is zero-padded to
+// (2 grid)^3 and convolved by FFT with the long-range Green's function
+// -G erf(r / 2rs) / r, which gives no periodic images. Forces come from
+// 4-point differences of the potential and are CIC-interpolated back.
+// With p3m on, the remaining short-range part (Plummer-softened force minus
+// the erf part) is summed directly over pairs closer than PMCutoff * rs.
+typedef complex<double> cplx;
+
+const double PMCutoff = 5.0;  // erfc(2.5) ~ 4e-4 of the pair force is dropped
+
+struct PMSolver {
+    int grid = 64;          // mesh nodes per side
+    double rs = 1.25;       // split radius in mesh cells
+    bool p3m = false;
+    double h = 0, ox = 0, oy = 0, oz = 0;  // cell size and mesh origin
+    vector<double> green;   // FFT of the Green's function / m^3 (real, since it is even)
+    vector<cplx> work;
+    vector<double> rho, phi, gx, gy, gz;
+    vector<cplx> lines;     // per-thread scratch lines for the strided FFT axes
+    vector<uint32_t> cellStart, cellList;
+};
+
+// In-place radix-2 FFT of n (power of two) contiguous values.
+static void fft1d(cplx* a, size_t n, bool inverse) {
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) swap(a[i], a[j]);
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        double ang = 2 * M_PI / len * (inverse ? 1 : -1);
+        cplx wl(cos(ang), sin(ang));
+        for (size_t i = 0; i < n; i += len) {
+            cplx w(1);
+            for (size_t k = 0; k < len / 2; k++) {
+                cplx u = a[i + k], v = a[i + k + len / 2] * w;
+                a[i + k] = u + v;
+                a[i + k + len / 2] = u - v;
+                w *= wl;
+            }
+        }
+    }
+}
+
+// Unnormalized 3D FFT of an m^3 array, one axis at a time, lines split
+// across the pool.
+static void fft3d(vector<cplx>& a, size_t m, bool inverse, vector<cplx>& lines, ThreadPool& pool) {
+    lines.resize(m * pool.size());
+    for (size_t stride : {size_t(1), m, m * m}) {
+        pool.run([&](int t) {
+            cplx* line = lines.data() + m * t;
+            for (size_t l = m * m * t / pool.size(); l < m * m * (t + 1) / pool.size(); l++) {
+                size_t base = stride == 1 ? l * m : stride == m ? (l / m) * m * m + l % m : l;
+                if (stride == 1) { fft1d(&a[base], m, inverse); continue; }
+                for (size_t k = 0; k < m; k++) line[k] = a[base + k * stride];
+                fft1d(line, m, inverse);
+                for (size_t k = 0; k < m; k++) a[base + k * stride] = line[k];
+            }
+        });
+    }
+}
+
+// erf-split long-range potential per unit mass at distance r.
+static double longRangePotential(double r, double rs) {
+    if (r < 1e-3 * rs) return -G / (rs * sqrt(M_PI));
+    return -G * erf(r / (2 * rs)) / r;
+}
+
+// Radial factor of the long-range force, g_L(r) / r, so that a = m dx * it.
+static double longRangeFactor(double r, double rs) {
+    double u = r / (2 * rs);
+    if (u < 1e-3) return 1 / (6 * sqrt(M_PI) * rs * rs * rs);
+    return erf(u) / (r * r * r) - exp(-u * u) / (rs * sqrt(M_PI) * r * r);
+}
+
+// Place the mesh so every particle is >= 3 cells from its edge (CIC plus the
+// difference stencil) with some slack; keep it until particles leave it or the
+// cloud shrinks to under half of it. Rebuilds the Green's function on change.
+static void placeMesh(const Particles& p, PMSolver& pm, ThreadPool& pool) {
+    if (p.n == 0) return;
+    double lo[3] = {p.x[0], p.y[0], p.z[0]}, hi[3] = {lo[0], lo[1], lo[2]};
+    for (size_t i = 0; i < p.n; i++) {
+        lo[0] = min(lo[0], p.x[i]); hi[0] = max(hi[0], p.x[i]);
+        lo[1] = min(lo[1], p.y[i]); hi[1] = max(hi[1], p.y[i]);
+        lo[2] = min(lo[2], p.z[i]); hi[2] = max(hi[2], p.z[i]);
+    }
+    const int ng = pm.grid;
+    double extent = max({hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2], 1e-9});
+    if (pm.h > 0) {
+        double o[3] = {pm.ox, pm.oy, pm.oz};
+        bool fits = extent > 0.5 * (ng - 8) * pm.h;
+        for (int d = 0; d < 3; d++)
+            fits = fits && lo[d] >= o[d] + 3 * pm.h && hi[d] < o[d] + (ng - 4) * pm.h;
+        if (fits) return;
+    }
+    pm.h = 1.1 * extent / (ng - 8);
+    pm.ox = 0.5 * (lo[0] + hi[0]) - pm.h * ng / 2;
+    pm.oy = 0.5 * (lo[1] + hi[1]) - pm.h * ng / 2;
+    pm.oz = 0.5 * (lo[2] + hi[2]) - pm.h * ng / 2;
+
+    const size_t m = 2 * ng;
+    const double rs = pm.rs * pm.h;
+    pm.work.assign(m * m * m, 0);
+    for (size_t i = 0; i < m; i++)
+        for (size_t j = 0; j < m; j++)
+            for (size_t k = 0; k < m; k++) {
+                double dx = i < m / 2 ? double(i) : double(i) - m;
+                double dy = j < m / 2 ? double(j) : double(j) - m;
+                double dz = k < m / 2 ? double(k) : double(k) - m;
+                pm.work[(i * m + j) * m + k] = longRangePotential(pm.h * sqrt(dx*dx + dy*dy + dz*dz), rs);
+            }
+    fft3d(pm.work, m, false, pm.lines, pool);
+    pm.green.resize(m * m * m);
+    for (size_t c = 0; c < pm.green.size(); c++) pm.green[c] = pm.work[c].real() / double(m * m * m);
+}
+
+static void meshForces(Particles& p, PMSolver& pm, ThreadPool& pool) {
+    const int ng = pm.grid;
+    const size_t m = 2 * ng, cells = size_t(ng) * ng * ng;
+    auto node = [ng](int i, int j, int k) { return (size_t(i) * ng + j) * ng + k; };
+    placeMesh(p, pm, pool);
+
+    // CIC assignment into one mesh per thread, summed in thread order.
+    const int T = pool.size();
+    pm.rho.assign(cells * T, 0.0);
+    pool.run([&](int t) {
+        double* rho = pm.rho.data() + cells * t;
+        for (size_t n = p.n * t / T; n < p.n * (t + 1) / T; n++) {
+            double u = (p.x[n] - pm.ox) / pm.h, v = (p.y[n] - pm.oy) / pm.h, w = (p.z[n] - pm.oz) / pm.h;
+            int i = int(u), j = int(v), k = int(w);
+            double fu = u - i, fv = v - j, fw = w - k;
+            for (int a = 0; a < 2; a++)
+                for (int b = 0; b < 2; b++)
+                    for (int c = 0; c < 2; c++)
+                        rho[node(i + a, j + b, k + c)] +=
+                            p.m[n] * (a ? fu : 1 - fu) * (b ? fv : 1 - fv) * (c ? fw : 1 - fw);
+        }
+    });
+    for (int t = 1; t < T; t++)
+        for (size_t c = 0; c < cells; c++) pm.rho[c] += pm.rho[cells * t + c];
+
+    fill(pm.work.begin(), pm.work.end(), cplx(0));
+    for (int i = 0; i < ng; i++)
+        for (int j = 0; j < ng; j++)
+            for (int k = 0; k < ng; k++) pm.work[(i * m + j) * m + k] = pm.rho[node(i, j, k)];
+    fft3d(pm.work, m, false, pm.lines, pool);
+    for (size_t c = 0; c < pm.work.size(); c++) pm.work[c] *= pm.green[c];
+    fft3d(pm.work, m, true, pm.lines, pool);
+    pm.phi.resize(cells);
+    for (int i = 0; i < ng; i++)
+        for (int j = 0; j < ng; j++)
+            for (int k = 0; k < ng; k++)
+                pm.phi[node(i, j, k)] = pm.work[(i * m + j) * m + k].real();
+
+    pm.gx.assign(cells, 0.0);
+    pm.gy.assign(cells, 0.0);
+    pm.gz.assign(cells, 0.0);
+    const double inv12h = 1 / (12 * pm.h);
+    pool.run([&](int t) {
+        for (int i = 2 + (ng - 4) * t / T; i < 2 + (ng - 4) * (t + 1) / T; i++)
+            for (int j = 2; j < ng - 2; j++)
+                for (int k = 2; k < ng - 2; k++) {
+                    const double* f = pm.phi.data();
+                    size_t c = node(i, j, k);
+                    pm.gx[c] = -(8 * (f[node(i+1, j, k)] - f[node(i-1, j, k)]) - (f[node(i+2, j, k)] - f[node(i-2, j, k)])) * inv12h;
+                    pm.gy[c] = -(8 * (f[node(i, j+1, k)] - f[node(i, j-1, k)]) - (f[node(i, j+2, k)] - f[node(i, j-2, k)])) * inv12h;
+                    pm.gz[c] = -(8 * (f[node(i, j, k+1)] - f[node(i, j, k-1)]) - (f[node(i, j, k+2)] - f[node(i, j, k-2)])) * inv12h;
+                }
+    });
+
+    pool.run([&](int t) {
+        for (size_t n = p.n * t / T; n < p.n * (t + 1) / T; n++) {
+            double u = (p.x[n] - pm.ox) / pm.h, v = (p.y[n] - pm.oy) / pm.h, w = (p.z[n] - pm.oz) / pm.h;
+            int i = int(u), j = int(v), k = int(w);
+            double fu = u - i, fv = v - j, fw = w - k;
+            double ax = 0, ay = 0, az = 0;
+            for (int a = 0; a < 2; a++)
+                for (int b = 0; b < 2; b++)
+                    for (int c = 0; c < 2; c++) {
+                        double wt = (a ? fu : 1 - fu) * (b ? fv : 1 - fv) * (c ? fw : 1 - fw);
+                        size_t q = node(i + a, j + b, k + c);
+                        ax += wt * pm.gx[q]; ay += wt * pm.gy[q]; az += wt * pm.gz[q];
+                    }
+            p.ax[n] = ax; p.ay[n] = ay; p.az[n] = az;
+        }
+    });
+}
+
+// P3M correction: chaining mesh of cell size rcut over the PM mesh volume,
+// then for each sink the 27 neighbouring cells.
+static void shortRangeForces(Particles& p, PMSolver& pm, ThreadPool& pool) {
+    const double rs = pm.rs * pm.h, rcut = PMCutoff * rs, eps2 = Softening * Softening;
+    const double span = pm.grid * pm.h;
+    const int nc = max(1, min(256, int(span / rcut)));
+    const double cs = span / nc;
+    auto cellOf = [&](double v, double o) { return clamp(int((v - o) / cs), 0, nc - 1); };
+    auto cellIndex = [&](size_t i) {
+        return (size_t(cellOf(p.x[i], pm.ox)) * nc + cellOf(p.y[i], pm.oy)) * nc + cellOf(p.z[i], pm.oz);
+    };
+    pm.cellStart.assign(size_t(nc) * nc * nc + 1, 0);
+    for (size_t i = 0; i < p.n; i++) pm.cellStart[cellIndex(i) + 1]++;
+    for (size_t c = 1; c < pm.cellStart.size(); c++) pm.cellStart[c] += pm.cellStart[c - 1];
+    pm.cellList.resize(p.n);
+    vector<uint32_t> fillPos(pm.cellStart.begin(), pm.cellStart.end() - 1);
+    for (size_t i = 0; i < p.n; i++) pm.cellList[fillPos[cellIndex(i)]++] = uint32_t(i);
+
+    pool.run([&](int t) {
+        for (size_t i = p.n * t / pool.size(); i < p.n * (t + 1) / pool.size(); i++) {
+            int ci = cellOf(p.x[i], pm.ox), cj = cellOf(p.y[i], pm.oy), ck = cellOf(p.z[i], pm.oz);
+            double ax = 0, ay = 0, az = 0;
+            for (int a = max(0, ci - 1); a <= min(nc - 1, ci + 1); a++)
+                for (int b = max(0, cj - 1); b <= min(nc - 1, cj + 1); b++)
+                    for (int c = max(0, ck - 1); c <= min(nc - 1, ck + 1); c++) {
+                        size_t cell = (size_t(a) * nc + b) * nc + c;
+                        for (uint32_t q = pm.cellStart[cell]; q < pm.cellStart[cell + 1]; q++) {
+                            uint32_t j = pm.cellList[q];
+                            double dx = p.x[j] - p.x[i], dy = p.y[j] - p.y[i], dz = p.z[j] - p.z[i];
+                            double r2 = dx*dx + dy*dy + dz*dz;
+                            if (r2 >= rcut * rcut || j == i) continue;
+                            double s2 = r2 + eps2;
+                            double f = G / (s2 * sqrt(s2)) - longRangeFactor(sqrt(r2), rs);
+                            ax += p.m[j] * f * dx; ay += p.m[j] * f * dy; az += p.m[j] * f * dz;
+                        }
+                    }
+            p.ax[i] += ax; p.ay[i] += ay; p.az[i] += az;
+        }
+    });
+}
+
+void accelPM(Particles& p, PMSolver& pm, ThreadPool& pool) {
+    meshForces(p, pm, pool);
+    if (pm.p3m) shortRangeForces(p, pm, pool);
+}
+
+enum class Method { Direct, BarnesHut, ParticleMesh };
+
+// Force-solver selection threaded through step(); owns reusable tree and
+// mesh storage.
+struct Solver {
+    Method method = Method::Direct;
+    Kernel kernel = Kernel::Scalar;
+    bool mixed = false;         // float pair interactions for the direct solver
+    double theta = 0.5;
+    Octree tree;
+    PMSolver mesh;
+    shared_ptr<ThreadPool> pool = make_shared<ThreadPool>(1);
+    ForceBuffers buffers;
+    MixedBuffers mixedBuffers;
+};
+
+void accelDirect(Particles& p, Solver& s) {
+    if (s.mixed) accelMixed(p, sinksOf(p), p.n, s.kernel, *s.pool, s.mixedBuffers);
+    else accel(p, s.kernel, *s.pool, s.buffers);
+}
+
+const char* methodName(const Solver& s) {
+    if (s.method == Method::BarnesHut) return "bh";
+    if (s.method == Method::ParticleMesh) return s.mesh.p3m ? "p3m" : "pm";
+    return "direct";
+}
+
+void computeAccel(Particles& p, Solver& s) {
+    if (s.method == Method::BarnesHut) accelTree(p, s.tree, s.theta, *s.pool);
+    else if (s.method == Method::ParticleMesh) accelPM(p, s.mesh, *s.pool);
+    else accelDirect(p, s);
+}
+
+void step(Particles& p, double dt, Solver& s) {
+    for (size_t i = 0; i < p.n; i++) {
+        p.vx[i] += p.ax[i] * 0.5 * dt;
+        p.vy[i] += p.ay[i] * 0.5 * dt;
+        p.vz[i] += p.az[i] * 0.5 * dt;
+        p.x[i] += p.vx[i] * dt;
+        p.y[i] += p.vy[i] * dt;
+        p.z[i] += p.vz[i] * dt;
     }
     
-    accel(stars);
+    computeAccel(p, s);
 
-    for (auto& s : stars) {
-        s.vx += s.ax * 0.5 * dt;
-        s.vy += s.ay * 0.5 * dt;
-        s.vz += s.az * 0.5 * dt;
+    for (size_t i = 0; i < p.n; i++) {
+        p.vx[i] += p.ax[i] * 0.5 * dt;
+        p.vy[i] += p.ay[i] * 0.5 * dt;
+        p.vz[i] += p.az[i] * 0.5 * dt;
+    }
+}
+
+// Hierarchical block time steps. Rung r advances with dtMax / 2^r and a
+// particle sits on the rung of dt_i = eta * sqrt(Softening / |a_i|). Each
+// rung runs kick-drift-kick: an opening half-kick when its step starts and a
+// closing half-kick, with forces recomputed for the active particles only,
+// when it ends. Everyone drifts together, so sources stay synchronized.
+struct BlockStepper {
+    int maxRung = 8;
+    double eta = 0.025;
+    vector<uint8_t> rung;
+    vector<uint32_t> active;
+    vector<double> sx, sy, sz, sax, say, saz;
+    uint64_t interactions = 0;  // sink-source force evaluations
+    int deepest = 0;            // finest rung used so far
+};
+
+static int rungFor(const Particles& p, size_t i, double dtMax, const BlockStepper& b) {
+    double a = sqrt(p.ax[i]*p.ax[i] + p.ay[i]*p.ay[i] + p.az[i]*p.az[i]);
+    if (a == 0) return 0;
+    double dt = b.eta * sqrt(Softening / a);
+    return clamp(int(ceil(log2(dtMax / dt))), 0, b.maxRung);
+}
+
+// Needs current accelerations (computeAccel) for every particle.
+void assignRungs(const Particles& p, double dtMax, BlockStepper& b) {
+    b.rung.resize(p.n);
+    for (size_t i = 0; i < p.n; i++) {
+        b.rung[i] = uint8_t(rungFor(p, i, dtMax, b));
+        b.deepest = max(b.deepest, int(b.rung[i]));
+    }
+}
+
+// Forces for the particles listed in b.active only.
+static void accelActive(Particles& p, Solver& s, BlockStepper& b) {
+    const size_t na = b.active.size();
+    b.interactions += uint64_t(na) * p.n;
+    if (na == p.n) { accelDirect(p, s); return; }
+    for (auto* v : {&b.sx, &b.sy, &b.sz, &b.sax, &b.say, &b.saz}) v->resize(na);
+    for (size_t k = 0; k < na; k++) {
+        uint32_t i = b.active[k];
+        b.sx[k] = p.x[i]; b.sy[k] = p.y[i]; b.sz[k] = p.z[i];
+    }
+    Sinks sinks = {b.sx.data(), b.sy.data(), b.sz.data(), b.sax.data(), b.say.data(), b.saz.data()};
+    if (s.mixed) accelMixed(p, sinks, na, s.kernel, *s.pool, s.mixedBuffers);
+    else accelSinks(p, sinks, na, s.kernel, *s.pool);
+    for (size_t k = 0; k < na; k++) {
+        uint32_t i = b.active[k];
+        p.ax[i] = b.sax[k]; p.ay[i] = b.say[k]; p.az[i] = b.saz[k];
     }
 }
 
-int main() {
-    int N = 100;
+// One step of dtMax, made of 2^maxRung ticks of the finest rung. Ticks on
+// which nobody finishes a step are skipped in a single drift.
+void blockStep(Particles& p, double dtMax, Solver& s, BlockStepper& b) {
+    const uint32_t ticks = 1u << b.maxRung;
+    const double dtMin = dtMax / ticks;
+    auto span = [&](int r) { return 1u << (b.maxRung - r); };
+    uint32_t t = 0;
+    while (t < ticks) {
+        uint32_t adv = ticks - t;
+        for (size_t i = 0; i < p.n; i++) {
+            uint32_t sp = span(b.rung[i]);
+            if (t % sp == 0) {
+                double h = 0.5 * sp * dtMin;
+                p.vx[i] += p.ax[i] * h; p.vy[i] += p.ay[i] * h; p.vz[i] += p.az[i] * h;
+            }
+            adv = min(adv, sp - t % sp);
+        }
+        double dt = adv * dtMin;
+        for (size_t i = 0; i < p.n; i++) {
+            p.x[i] += p.vx[i] * dt;
+            p.y[i] += p.vy[i] * dt;
+            p.z[i] += p.vz[i] * dt;
+        }
+        t += adv;
+
+        b.active.clear();
+        for (size_t i = 0; i < p.n; i++)
+            if (t % span(b.rung[i]) == 0) b.active.push_back(uint32_t(i));
+        accelActive(p, s, b);
+        for (uint32_t i : b.active) {
+            int r = b.rung[i];
+            double h = 0.5 * span(r) * dtMin;
+            p.vx[i] += p.ax[i] * h; p.vy[i] += p.ay[i] * h; p.vz[i] += p.az[i] * h;
+            // Refine freely; coarsen one rung at a time, and only on a tick
+            // where the coarser rung's step boundary lines up.
+            int want = rungFor(p, i, dtMax, b);
+            if (want > r) r = want;
+            else if (want < r && t % span(r - 1) == 0) r--;
+            b.rung[i] = uint8_t(r);
+            b.deepest = max(b.deepest, r);
+        }
+    }
+}
+
+// Total energy with the same softened potential the forces use.
+double energy(const Particles& p) {
+    const double eps2 = Softening * Softening;
+    double kin = 0, pot = 0;
+    for (size_t i = 0; i < p.n; i++) {
+        kin += 0.5 * p.m[i] * (p.vx[i]*p.vx[i] + p.vy[i]*p.vy[i] + p.vz[i]*p.vz[i]);
+        for (size_t j = i + 1; j < p.n; j++) {
+            double dx = p.x[j] - p.x[i], dy = p.y[j] - p.y[i], dz = p.z[j] - p.z[i];
+            pot -= G * p.m[i] * p.m[j] / sqrt(dx*dx + dy*dy + dz*dz + eps2);
+        }
+    }
+    return kin + pot;
+}
+
+// Binary snapshot, version 1, little-endian:
+//   128-byte SnapshotHeader
+//   7 columns x, y, z, vx, vy, vz, m of n doubles each, every column
+//   starting at header + c * columnBytes (columnBytes is a multiple of 64).
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;
+    uint64_t n;
+    uint64_t step;
+    double time;
+    double dt;
+    uint64_t seed;
+    uint64_t columnBytes;
+    uint8_t reserved[64];
+};
+static_assert(sizeof(SnapshotHeader) == 128, "snapshot header layout");
+
+const char SnapshotMagic[8] = {'N', 'B', 'O', 'D', 'Y', 'S', 'N', 'P'};
+const uint32_t SnapshotVersion = 1;
+const int SnapshotColumns = 7;
+
+static bool hostLittleEndian() {
+    const uint16_t probe = 1;
+    return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+}
+
+template <class T>
+static T byteSwap(T v) {
+    uint8_t b[sizeof(T)];
+    memcpy(b, &v, sizeof(T));
+    reverse(b, b + sizeof(T));
+    memcpy(&v, b, sizeof(T));
+    return v;
+}
+
+static void swapHeader(SnapshotHeader& h) {
+    h.version = byteSwap(h.version); h.headerBytes = byteSwap(h.headerBytes);
+    h.n = byteSwap(h.n); h.step = byteSwap(h.step);
+    h.time = byteSwap(h.time); h.dt = byteSwap(h.dt);
+    h.seed = byteSwap(h.seed); h.columnBytes = byteSwap(h.columnBytes);
+}
+
+SnapshotHeader makeHeader(size_t n, uint64_t step, double time, double dt, uint64_t seed) {
+    SnapshotHeader h = {};
+    memcpy(h.magic, SnapshotMagic, 8);
+    h.version = SnapshotVersion;
+    h.headerBytes = sizeof(SnapshotHeader);
+    h.n = n;
+    h.step = step;
+    h.time = time;
+    h.dt = dt;
+    h.seed = seed;
+    h.columnBytes = (n * sizeof(double) + 63) & ~uint64_t(63);
+    return h;
+}
+
+// Writes header + columns (columns[c] holds n doubles) to path via a
+// temporary file and rename, so a crash never leaves a torn checkpoint.
+bool writeSnapshot(const string& path, SnapshotHeader h, const double* const* columns) {
+    const size_t n = h.n, colBytes = h.columnBytes;
+    string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool swap = !hostLittleEndian();
+    if (swap) swapHeader(h);
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    vector<double> swapped;
+    static const char zeros[64] = {};
+    for (int c = 0; c < SnapshotColumns && ok; c++) {
+        const double* col = columns[c];
+        if (swap) {
+            swapped.assign(col, col + n);
+            for (double& v : swapped) v = byteSwap(v);
+            col = swapped.data();
+        }
+        ok = fwrite(col, sizeof(double), n, f) == n &&
+             fwrite(zeros, 1, colBytes - n * sizeof(double), f) == colBytes - n * sizeof(double);
+    }
+    ok = fclose(f) == 0 && ok;
+    if (ok) ok = rename(tmp.c_str(), path.c_str()) == 0;
+    if (!ok) remove(tmp.c_str());
+    return ok;
+}
+
+// Restart: map the snapshot privately and point the particle columns at it,
+// no copy. Big-endian hosts fall back to reading and swapping.
+bool mapSnapshot(const string& path, Particles& p, SnapshotHeader& h) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(SnapshotHeader)) { close(fd); return false; }
+    size_t bytes = st.st_size;
+    void* map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    memcpy(&h, map, sizeof(h));
+    bool swap = !hostLittleEndian();
+    if (swap) swapHeader(h);
+    if (memcmp(h.magic, SnapshotMagic, 8) != 0 || h.version != SnapshotVersion ||
+        h.headerBytes < sizeof(SnapshotHeader) || h.columnBytes < h.n * sizeof(double) ||
+        h.columnBytes % 64 != 0 || bytes < h.headerBytes + SnapshotColumns * h.columnBytes) {
+        munmap(map, bytes);
+        return false;
+    }
+    double* columns = reinterpret_cast<double*>(static_cast<char*>(map) + h.headerBytes);
+    size_t colStride = h.columnBytes / sizeof(double);
+    if (swap) {
+        p.resize(h.n);
+        double* cols[SnapshotColumns] = {p.x, p.y, p.z, p.vx, p.vy, p.vz, p.m};
+        for (int c = 0; c < SnapshotColumns; c++)
+            for (size_t i = 0; i < h.n; i++) cols[c][i] = byteSwap(columns[c * colStride + i]);
+        munmap(map, bytes);
+        return true;
+    }
+    p.adopt(map, bytes, columns, h.n, colStride);
+    return true;
+}
+
+// Background checkpoint writer with two staging buffers. submit() copies the
+// state into the buffer the writer thread is not using and returns; the disk
+// write overlaps with integration. If the previous checkpoint is still
+// queued when the next one arrives, the queued one is replaced rather than
+// making the integrator wait.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const string& directory) : dir(directory), worker([this] { loop(); }) {}
+    ~SnapshotWriter() { finish(); }
+
+    // Writes whatever is still queued, then stops the thread.
+    void finish() {
+        {
+            lock_guard<mutex> lk(mu);
+            quit = true;
+        }
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    void submit(const Particles& p, uint64_t step, double time, double dt, uint64_t seed) {
+        lock_guard<mutex> lk(mu);
+        int b = pending >= 0 ? pending : (writing == 0 ? 1 : 0);
+        if (pending >= 0) replaced++;
+        Buffer& buf = buffers[b];
+        buf.header = makeHeader(p.n, step, time, dt, seed);
+        buf.data.resize(SnapshotColumns * p.n);
+        const double* cols[SnapshotColumns] = {p.x, p.y, p.z, p.vx, p.vy, p.vz, p.m};
+        for (int c = 0; c < SnapshotColumns; c++) copy(cols[c], cols[c] + p.n, buf.data.begin() + c * p.n);
+        char name[64];
+        snprintf(name, sizeof(name), "/snap_%06llu.nbs", (unsigned long long)step);
+        buf.path = dir + name;
+        pending = b;
+        wake.notify_one();
+    }
+    uint64_t writtenCount() { lock_guard<mutex> lk(mu); return written; }
+    uint64_t replacedCount() { lock_guard<mutex> lk(mu); return replaced; }
+    uint64_t failedCount() { lock_guard<mutex> lk(mu); return failed; }
+
+private:
+    struct Buffer {
+        SnapshotHeader header;
+        vector<double> data;
+        string path;
+    };
+
+    void loop() {
+        for (;;) {
+            int b;
+            {
+                unique_lock<mutex> lk(mu);
+                wake.wait(lk, [&] { return quit || pending >= 0; });
+                if (pending < 0) return;
+                b = writing = pending;
+                pending = -1;
+            }
+            Buffer& buf = buffers[b];
+            const size_t n = buf.header.n;
+            const double* cols[SnapshotColumns];
+            for (int c = 0; c < SnapshotColumns; c++) cols[c] = buf.data.data() + c * n;
+            bool ok = writeSnapshot(buf.path, buf.header, cols);
+            lock_guard<mutex> lk(mu);
+            writing = -1;
+            if (ok) written++;
+            else {
+                failed++;
+                fprintf(stderr, "snapshot: failed to write %s\n", buf.path.c_str());
+            }
+        }
+    }
+
+    string dir;
+    Buffer buffers[2];
+    int writing = -1, pending = -1;
+    uint64_t written = 0, replaced = 0, failed = 0;
+    bool quit = false;
+    mutex mu;
+    condition_variable wake;
+    thread worker;
+};
+
+struct Options {
+    int n = 100;
+    int steps = 100;
     double dt = 0.01;
-    vector<Star> stars(N);
-    mt19937 gen(42);
+    unsigned seed = 42;
+    string kernel = "auto";
+    string solver = "direct";
+    double theta = 0.5;
+    int leaf = 8;
+    int threads = max(1u, thread::hardware_concurrency());
+    bool scaling = false;
+    string ic = "uniform";
+    bool block = false;
+    bool blockCompare = false;
+    double eta = 0.025;
+    int rungs = 8;
+    int grid = 64;
+    double rs = 1.25;
+    int snapEvery = 0;
+    string snapDir = ".";
+    string restart;
+    string precision = "double";
+    bool comparePrecision = false;
+    bool bench = false;
+    bool check = false;
+};
+
+Options parseArgs(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        size_t eq = a.find('=');
+        string key = a.substr(0, eq), val = eq == string::npos ? "" : a.substr(eq + 1);
+        if (key == "--n") o.n = stoi(val);
+        else if (key == "--steps") o.steps = stoi(val);
+        else if (key == "--dt") o.dt = stod(val);
+        else if (key == "--seed") o.seed = stoul(val);
+        else if (key == "--kernel") o.kernel = val;
+        else if (key == "--solver") o.solver = val;
+        else if (key == "--theta") o.theta = stod(val);
+        else if (key == "--leaf") o.leaf = stoi(val);
+        else if (key == "--threads") o.threads = stoi(val);
+        else if (key == "--scaling") o.scaling = true;
+        else if (key == "--ic") o.ic = val;
+        else if (key == "--block") o.block = true;
+        else if (key == "--block-compare") o.blockCompare = true;
+        else if (key == "--eta") o.eta = stod(val);
+        else if (key == "--rungs") o.rungs = stoi(val);
+        else if (key == "--grid") o.grid = stoi(val);
+        else if (key == "--rs") o.rs = stod(val);
+        else if (key == "--snap-every") o.snapEvery = stoi(val);
+        else if (key == "--snap-dir") o.snapDir = val;
+        else if (key == "--restart") o.restart = val;
+        else if (key == "--precision") o.precision = val;
+        else if (key == "--compare-precision") o.comparePrecision = true;
+        else if (key == "--bench") o.bench = true;
+        else if (key == "--check") o.check = true;
+        else {
+            fprintf(stderr, "unknown option %s\n"
+                    "usage: %s [--n=N] [--steps=S] [--dt=DT] [--seed=S]\n"
+                    "          [--kernel=auto|scalar|avx2|avx512] [--solver=direct|bh|pm|p3m]\n"
+                    "          [--theta=T] [--leaf=L] [--threads=T] [--ic=uniform|clustered]\n"
+                    "          [--block] [--eta=E] [--rungs=R] [--grid=G] [--rs=CELLS]\n"
+                    "          [--snap-every=K] [--snap-dir=DIR] [--restart=FILE]\n"
+                    "          [--precision=double|mixed]\n"
+                    "          [--check] [--bench] [--scaling] [--block-compare] [--compare-precision]\n", a.c_str(), argv[0]);
+            exit(1);
+        }
+    }
+    if (o.n < 1) {
+        fprintf(stderr, "--n must be at least 1\n");
+        exit(1);
+    }
+    return o;
+}
+
+Kernel pickKernel(const string& name) {
+    Kernel k = detectKernel();
+    if (name == "scalar") k = Kernel::Scalar;
+    else if (name == "avx2") k = Kernel::AVX2;
+    else if (name == "avx512") k = Kernel::AVX512;
+    if (!kernelSupported(k)) {
+        fprintf(stderr, "kernel %s not supported on this CPU, using %s\n", kernelName(k), kernelName(detectKernel()));
+        k = detectKernel();
+    }
+    return k;
+}
+
+Solver makeSolver(const Options& o) {
+    Solver s;
+    if (o.solver == "bh") s.method = Method::BarnesHut;
+    else if (o.solver == "pm" || o.solver == "p3m") s.method = Method::ParticleMesh;
+    else if (o.solver != "direct") {
+        fprintf(stderr, "unknown solver %s\n", o.solver.c_str());
+        exit(1);
+    }
+    s.kernel = pickKernel(o.kernel);
+    s.theta = o.theta;
+    s.tree.leafSize = o.leaf;
+    s.mesh.grid = o.grid;
+    s.mesh.rs = o.rs;
+    s.mesh.p3m = o.solver == "p3m";
+    if (o.precision != "double" && o.precision != "mixed") {
+        fprintf(stderr, "unknown precision %s\n", o.precision.c_str());
+        exit(1);
+    }
+    s.mixed = o.precision == "mixed";
+    if (s.mixed && s.method != Method::Direct) fprintf(stderr, "--precision=mixed only affects --solver=direct\n");
+    if (s.method == Method::ParticleMesh && (o.grid < 16 || (o.grid & (o.grid - 1)))) {
+        fprintf(stderr, "--grid must be a power of two >= 16\n");
+        exit(1);
+    }
+    s.pool = make_shared<ThreadPool>(o.threads);
+    return s;
+}
+
+// "uniform": unit masses in a 20^3 cube (the original setup). "clustered":
+// the same background for 95% of the particles plus four compact Plummer
+// clumps holding the rest, which is where block time steps pay off.
+void initParticles(Particles& p, unsigned seed, const string& ic = "uniform") {
+    mt19937 gen(seed);
     uniform_real_distribution<double> dist(-10, 10);
     uniform_real_distribution<double> vdist(-0.1, 0.1);
+    size_t background = ic == "clustered" ? p.n * 19 / 20 : p.n;
+    for (size_t i = 0; i < background; i++) {
+        p.x[i] = dist(gen); p.y[i] = dist(gen); p.z[i] = dist(gen);
+        p.vx[i] = vdist(gen); p.vy[i] = vdist(gen); p.vz[i] = vdist(gen);
+        p.m[i] = 1.0;
+    }
+    if (background == p.n) return;
+    const int clumps = 4;
+    const double a = 0.1;
+    uniform_real_distribution<double> u(0, 1);
+    normal_distribution<double> gauss(0, 1);
+    double cx[clumps], cy[clumps], cz[clumps];
+    for (int c = 0; c < clumps; c++) { cx[c] = 0.6 * dist(gen); cy[c] = 0.6 * dist(gen); cz[c] = 0.6 * dist(gen); }
+    double clumpMass = double(p.n - background) / clumps;
+    double sigma = sqrt(G * clumpMass / (6 * a));
+    for (size_t i = background; i < p.n; i++) {
+        int c = int(i % clumps);
+        double r = a / sqrt(pow(max(u(gen), 1e-6), -2.0 / 3) - 1);
+        r = min(r, 10 * a);
+        double cosT = 2 * u(gen) - 1, phi = 2 * M_PI * u(gen), sinT = sqrt(1 - cosT * cosT);
+        p.x[i] = cx[c] + r * sinT * cos(phi);
+        p.y[i] = cy[c] + r * sinT * sin(phi);
+        p.z[i] = cz[c] + r * cosT;
+        p.vx[i] = sigma * gauss(gen); p.vy[i] = sigma * gauss(gen); p.vz[i] = sigma * gauss(gen);
+        p.m[i] = 1.0;
+    }
+}
+
+vector<Star> toStars(const Particles& p) {
+    vector<Star> stars(p.n);
+    for (size_t i = 0; i < p.n; i++)
+        stars[i] = {p.x[i], p.y[i], p.z[i], p.vx[i], p.vy[i], p.vz[i], 0, 0, 0, p.m[i]};
+    return stars;
+}
 
-    for (int i = 0; i < N; i++) {
-        stars[i] = {dist(gen), dist(gen), dist(gen), vdist(gen), vdist(gen), vdist(gen), 0, 0, 0, 1.0};
+// Max and RMS of |a - a_ref| / |a_ref| over all particles.
+void forceError(const Particles& p, const vector<Star>& ref, double& maxErr, double& rmsErr) {
+    maxErr = 0;
+    double sum = 0;
+    for (size_t i = 0; i < p.n; i++) {
+        double dx = p.ax[i] - ref[i].ax, dy = p.ay[i] - ref[i].ay, dz = p.az[i] - ref[i].az;
+        double a2 = ref[i].ax*ref[i].ax + ref[i].ay*ref[i].ay + ref[i].az*ref[i].az;
+        double e = sqrt((dx*dx + dy*dy + dz*dz) / a2);
+        maxErr = max(maxErr, e);
+        sum += e * e;
     }
+    rmsErr = sqrt(sum / p.n);
+}
+
+template <class F>
+double secondsPerCall(F f) {
+    auto t0 = chrono::steady_clock::now();
+    int calls = 0;
+    double elapsed = 0;
+    do {
+        f();
+        calls++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    } while (elapsed < 0.5);
+    return elapsed / calls;
+}
+
+// Every SoA kernel must reproduce the reference accelerations to within
+// 1e-12 relative; only summation order (and rsqrt refinement) differ.
+const double KernelTolerance = 1e-12;
 
-    accel(stars);
+int runCheck(const Options& o) {
+    Particles p(o.n);
+    initParticles(p, o.seed);
+    vector<Star> ref = toStars(p);
+    accel(ref);
+    bool ok = true;
+    for (Kernel k : {Kernel::Scalar, Kernel::AVX2, Kernel::AVX512}) {
+        if (!kernelSupported(k)) continue;
+        accel(p, k);
+        double maxErr, rmsErr;
+        forceError(p, ref, maxErr, rmsErr);
+        bool pass = maxErr <= KernelTolerance;
+        ok = ok && pass;
+        printf("%-7s max rel err %.3e | rms %.3e | %s\n", kernelName(k), maxErr, rmsErr, pass ? "ok" : "FAIL");
+    }
+
+    // Parallel path: same tolerance, and two runs must match bit for bit.
+    ThreadPool pool(o.threads);
+    ForceBuffers fb;
+    for (Kernel k : {Kernel::Scalar, Kernel::AVX2, Kernel::AVX512}) {
+        if (!kernelSupported(k)) continue;
+        accel(p, k, pool, fb);
+        Particles first = p;
+        accel(p, k, pool, fb);
+        bool same = memcmp(first.ax, p.ax, p.n * sizeof(double)) == 0 &&
+                    memcmp(first.ay, p.ay, p.n * sizeof(double)) == 0 &&
+                    memcmp(first.az, p.az, p.n * sizeof(double)) == 0;
+        double maxErr, rmsErr;
+        forceError(p, ref, maxErr, rmsErr);
+        bool pass = same && maxErr <= KernelTolerance;
+        ok = ok && pass;
+        printf("%-7s threads=%d max rel err %.3e | reproducible %s | %s\n", kernelName(k), pool.size(),
+               maxErr, same ? "yes" : "no", pass ? "ok" : "FAIL");
+    }
+    return ok ? 0 : 1;
+}
 
-    printf("N-Body Simulation (N=%d)\n", N);
-    for (int i = 0; i < 100; i++) {
-        step(stars, dt);
+// Tree or mesh forces against direct summation on an evenly spaced sample of
+// sinks, so the check stays affordable at N ~ 1e6.
+int checkApprox(const Options& o) {
+    Particles p(o.n);
+    initParticles(p, o.seed, o.ic);
+    Solver s = makeSolver(o);
+    auto t0 = chrono::steady_clock::now();
+    computeAccel(p, s);
+    double tApprox = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    size_t samples = min<size_t>(p.n, 1000);
+    double maxErr = 0, sum = 0;
+    t0 = chrono::steady_clock::now();
+    for (size_t k = 0; k < samples; k++) {
+        size_t i = k * p.n / samples;
+        double ax = 0, ay = 0, az = 0;
+        sumDirect(p, p.x[i], p.y[i], p.z[i], 0, p.n, ax, ay, az);
+        ax *= G; ay *= G; az *= G;
+        double dx = p.ax[i] - ax, dy = p.ay[i] - ay, dz = p.az[i] - az;
+        double e = sqrt((dx*dx + dy*dy + dz*dz) / (ax*ax + ay*ay + az*az));
+        maxErr = max(maxErr, e);
+        sum += e * e;
+    }
+    double tDirect = chrono::duration<double>(chrono::steady_clock::now() - t0).count() * p.n / samples;
+    if (s.method == Method::BarnesHut)
+        printf("Barnes-Hut N=%d theta=%.2f leaf=%d nodes=%zu threads=%d\n", o.n, o.theta, o.leaf,
+               s.tree.nodes.size(), s.pool->size());
+    else
+        printf("%s N=%d grid=%d rs=%.2f cells (h=%.4g) threads=%d\n", methodName(s), o.n, o.grid, o.rs,
+               s.mesh.h, s.pool->size());
+    printf("force error vs direct (%zu sinks): max %.3e | rms %.3e\n", samples, maxErr, sqrt(sum / samples));
+    printf("%s %.3f s | direct (scalar, extrapolated) %.3f s | %.1fx\n", methodName(s), tApprox, tDirect,
+           tDirect / tApprox);
+    return 0;
+}
+
+// Strong scaling of one direct force evaluation: N = 1k..64k, threads
+// doubling from 1 up to --threads (which defaults to all cores).
+int runScaling(const Options& o) {
+    Kernel k = pickKernel(o.kernel);
+    vector<int> counts;
+    for (int t = 1; t < o.threads; t *= 2) counts.push_back(t);
+    counts.push_back(o.threads);
+    printf("strong scaling, kernel=%s, ms per force evaluation (speedup)\n%8s", kernelName(k), "N");
+    for (int t : counts) printf(" | %6d thr        ", t);
+    printf("\n");
+    for (int n = 1024; n <= 65536; n *= 2) {
+        Particles p(n);
+        initParticles(p, o.seed);
+        ForceBuffers fb;
+        double t1 = 0;
+        printf("%8d", n);
+        for (int t : counts) {
+            ThreadPool pool(t);
+            double sec = secondsPerCall([&] { accel(p, k, pool, fb); });
+            if (t == 1) t1 = sec;
+            printf(" | %9.2f (%5.2fx)", sec * 1e3, t1 / sec);
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+    return 0;
+}
+
+// Block steps vs a fixed step equal to the finest rung the block run needed,
+// over the same total time: force evaluations and relative energy error.
+int runBlockCompare(const Options& o) {
+    Solver s = makeSolver(o);
+    s.method = Method::Direct;
+    Particles ic(o.n);
+    initParticles(ic, o.seed, o.ic);
+
+    Particles p = ic;
+    BlockStepper b;
+    b.maxRung = o.rungs;
+    b.eta = o.eta;
+    computeAccel(p, s);
+    double e0 = energy(p);
+    assignRungs(p, o.dt, b);
+    auto t0 = chrono::steady_clock::now();
+    for (int i = 0; i < o.steps; i++) blockStep(p, o.dt, s, b);
+    double tBlock = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    double errBlock = fabs((energy(p) - e0) / e0);
+    vector<size_t> hist(b.maxRung + 1);
+    for (uint8_t r : b.rung) hist[r]++;
+
+    Particles q = ic;
+    int sub = 1 << b.deepest;
+    double dtFixed = o.dt / sub;
+    computeAccel(q, s);
+    uint64_t fixedInteractions = 0;
+    t0 = chrono::steady_clock::now();
+    for (int i = 0; i < o.steps * sub; i++) {
+        step(q, dtFixed, s);
+        fixedInteractions += uint64_t(q.n) * q.n;
+    }
+    double tFixed = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    double errFixed = fabs((energy(q) - e0) / e0);
+
+    printf("N=%d ic=%s dtMax=%g eta=%g steps=%d, final rungs:", o.n, o.ic.c_str(), o.dt, o.eta, o.steps);
+    for (int r = 0; r <= b.maxRung; r++) if (hist[r]) printf(" r%d:%zu", r, hist[r]);
+    printf("\n%-22s %14s %12s %10s\n", "", "interactions", "|dE/E|", "time s");
+    printf("%-22s %14llu %12.3e %10.3f\n", "block steps", (unsigned long long)b.interactions, errBlock, tBlock);
+    printf("fixed dt=dtMax/%-7d %14llu %12.3e %10.3f\n", sub, (unsigned long long)fixedInteractions, errFixed, tFixed);
+    printf("force evaluations saved: %.1fx\n", double(fixedInteractions) / b.interactions);
+    return 0;
+}
+
+// Mixed vs pure double direct forces (same kernel family, same threads):
+// RMS and max relative force error, and throughput of both paths.
+int runComparePrecision(const Options& o) {
+    Solver s = makeSolver(o);
+    Particles p(o.n);
+    initParticles(p, o.seed, o.ic);
+    accel(p, s.kernel, *s.pool, s.buffers);
+    vector<double> ref[3] = {vector<double>(p.ax, p.ax + p.n), vector<double>(p.ay, p.ay + p.n),
+                             vector<double>(p.az, p.az + p.n)};
+    accelMixed(p, sinksOf(p), p.n, s.kernel, *s.pool, s.mixedBuffers);
+    double maxErr = 0, sum = 0;
+    for (size_t i = 0; i < p.n; i++) {
+        double dx = p.ax[i] - ref[0][i], dy = p.ay[i] - ref[1][i], dz = p.az[i] - ref[2][i];
+        double a2 = ref[0][i]*ref[0][i] + ref[1][i]*ref[1][i] + ref[2][i]*ref[2][i];
+        double e = sqrt((dx*dx + dy*dy + dz*dz) / a2);
+        maxErr = max(maxErr, e);
+        sum += e * e;
+    }
+    double pairs = 0.5 * o.n * (o.n - 1.0);
+    double tDouble = secondsPerCall([&] { accel(p, s.kernel, *s.pool, s.buffers); });
+    double tMixed = secondsPerCall([&] { accelMixed(p, sinksOf(p), p.n, s.kernel, *s.pool, s.mixedBuffers); });
+    printf("N=%d kernel=%s threads=%d\n", o.n, kernelName(s.kernel), s.pool->size());
+    printf("mixed vs double force error: rms %.3e | max %.3e\n", sqrt(sum / p.n), maxErr);
+    printf("double %8.3f ms | %8.2f Mpairs/s\n", tDouble * 1e3, pairs / tDouble * 1e-6);
+    printf("mixed  %8.3f ms | %8.2f Mpairs/s | %.2fx\n", tMixed * 1e3, pairs / tMixed * 1e-6, tDouble / tMixed);
+    return 0;
+}
+
+int runBench(const Options& o) {
+    Particles p(o.n);
+    initParticles(p, o.seed);
+    vector<Star> stars = toStars(p);
+    double pairs = 0.5 * o.n * (o.n - 1.0);
+    double tRef = secondsPerCall([&] { accel(stars); });
+    printf("N=%d\n%-7s %8.3f ms | %8.2f Mpairs/s\n", o.n, "aos", tRef * 1e3, pairs / tRef * 1e-6);
+    for (Kernel k : {Kernel::Scalar, Kernel::AVX2, Kernel::AVX512}) {
+        if (!kernelSupported(k)) continue;
+        double t = secondsPerCall([&] { accel(p, k); });
+        printf("%-7s %8.3f ms | %8.2f Mpairs/s | %5.2fx\n", kernelName(k), t * 1e3, pairs / t * 1e-6, tRef / t);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Options o = parseArgs(argc, argv);
+    if (o.check) return o.solver == "direct" ? runCheck(o) : checkApprox(o);
+    if (o.bench) return runBench(o);
+    if (o.scaling) return runScaling(o);
+    if (o.blockCompare) return runBlockCompare(o);
+    if (o.comparePrecision) return runComparePrecision(o);
+
+    Solver solver = makeSolver(o);
+    Particles p;
+    double dt = o.dt, time = 0;
+    uint64_t seed = o.seed, start = 0;
+    if (!o.restart.empty()) {
+        SnapshotHeader h;
+        if (!mapSnapshot(o.restart, p, h)) {
+            fprintf(stderr, "cannot restart from %s\n", o.restart.c_str());
+            return 1;
+        }
+        dt = h.dt; time = h.time; seed = h.seed; start = h.step;
+        printf("Restart from %s: step %llu, t = %g\n", o.restart.c_str(), (unsigned long long)start, time);
+    } else {
+        p.resize(o.n);
+        initParticles(p, seed, o.ic);
+    }
+    int N = int(p.n);
+
+    computeAccel(p, solver);
+
+    BlockStepper block;
+    if (o.block) {
+        if (solver.method != Method::Direct) {
+            fprintf(stderr, "--block needs --solver=direct\n");
+            return 1;
+        }
+        block.maxRung = o.rungs;
+        block.eta = o.eta;
+        assignRungs(p, dt, block);
+    }
+    unique_ptr<SnapshotWriter> writer;
+    if (o.snapEvery > 0) writer.reset(new SnapshotWriter(o.snapDir));
+
+    printf("N-Body Simulation (N=%d, solver=%s, kernel=%s, threads=%d%s)\n", N, methodName(solver),
+           kernelName(solver.kernel), solver.pool->size(), solver.mixed ? ", mixed precision" : "");
+    for (int i = 0; i < o.steps; i++) {
+        if (o.block) blockStep(p, dt, solver, block);
+        else step(p, dt, solver);
+        time += dt;
+        uint64_t done = start + i + 1;
+        if (writer && done % o.snapEvery == 0) writer->submit(p, done, time, dt, seed);
         if (i % 20 == 0) {
             double tx = 0, ty = 0, tz = 0;
-            for (auto& s : stars) { tx += s.x; ty += s.y; tz += s.z; }
-            printf("Step %d | Center of Mass: (%.4f, %.4f, %.4f)\n", i, tx/N, ty/N, tz/N);
+            for (size_t k = 0; k < p.n; k++) { tx += p.x[k]; ty += p.y[k]; tz += p.z[k]; }
+            printf("Step %llu | Center of Mass: (%.4f, %.4f, %.4f)\n", (unsigned long long)(start + i), tx/N, ty/N, tz/N);
         }
     }
+    if (o.block)
+        printf("Block steps: %llu interactions, finest rung %d\n", (unsigned long long)block.interactions, block.deepest);
+    if (writer) {
+        writer->finish();
+        printf("Snapshots: %llu written, %llu replaced while queued, %llu failed\n",
+               (unsigned long long)writer->writtenCount(), (unsigned long long)writer->replacedCount(),
+               (unsigned long long)writer->failedCount());
+    }
 
     return 0;
 }
@@ -1,7 +1,14 @@
 #include <raylib.h>
+#include <rlgl.h>
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 
 const int WIDTH = 1400;
 const int HEIGHT = 900;
@@ -13,8 +20,8 @@ struct Body {
     float radius;
     Color color;
     std::string name;
-    std::vector<Vector2> trail;
     bool drawTrail;
+    int id = -1;
 
     Body(Vector2 p, Vector2 v, float m, float r, Color c, const std::string& n, bool trail = true)
         : pos(p), vel(v), mass(m), radius(r), color(c), name(n), drawTrail(trail) {}
@@ -39,77 +46,450 @@ struct Body {
         vel.y += accel.y * dt;
         pos.x += vel.x * dt;
         pos.y += vel.y * dt;
+    }
+
+    void draw(Vector2 at, float r) const {
+        DrawCircleV(at, r, color);
 
-        if (drawTrail) {
-            trail.push_back(pos);
-            if (trail.size() > 600) trail.erase(trail.begin());
+        if (!name.empty()) {
+            int textW = MeasureText(name.c_str(), 14);
+            DrawText(name.c_str(), at.x - textW / 2, at.y - r - 20, 14, WHITE);
         }
     }
+};
 
-    void draw() const {
-        if (drawTrail && trail.size() > 1) {
-            for (size_t i = 1; i < trail.size(); ++i) {
-                float alpha = (float)i / trail.size();
-                Color trailCol = color;
-                trailCol.a = (unsigned char)(alpha * 80);
-                DrawLineV(trail[i-1], trail[i], trailCol);
-            }
+// Trail points for every body in one preallocated block, Capacity points per
+// body, used as a ring buffer: pushing overwrites the oldest point in O(1).
+// Each trail is drawn as a single rlgl line batch with the same fade as the
+// old per-segment DrawLineV calls.
+class TrailStore {
+public:
+    static const int Capacity = 600;
+
+    explicit TrailStore(size_t bodies) : points(bodies * Capacity), head(bodies, 0), count(bodies, 0) {}
+
+    void push(size_t k, Vector2 p) {
+        points[k * Capacity + head[k]] = p;
+        head[k] = (head[k] + 1) % Capacity;
+        if (count[k] < Capacity) count[k]++;
+    }
+    void clear() {
+        std::fill(head.begin(), head.end(), 0);
+        std::fill(count.begin(), count.end(), 0);
+    }
+
+    void draw(size_t k, Color c) const {
+        int n = count[k];
+        if (n < 2) return;
+        const Vector2* ring = &points[k * Capacity];
+        int first = (head[k] - n + Capacity) % Capacity;
+        rlCheckRenderBatchLimit(2 * (n - 1));
+        rlBegin(RL_LINES);
+        Vector2 a = ring[first];
+        for (int i = 1; i < n; i++) {
+            Vector2 b = ring[(first + i) % Capacity];
+            unsigned char alpha = (unsigned char)((float)i / n * 80);
+            rlColor4ub(c.r, c.g, c.b, alpha);
+            rlVertex2f(a.x, a.y);
+            rlVertex2f(b.x, b.y);
+            a = b;
         }
+        rlEnd();
+    }
 
-        DrawCircleV(pos, radius, color);
+private:
+    std::vector<Vector2> points;
+    std::vector<int> head, count;
+};
 
-        if (!name.empty()) {
-            int textW = MeasureText(name.c_str(), 14);
-            DrawText(name.c_str(), pos.x - textW / 2, pos.y - radius - 20, 14, WHITE);
+// Uniform grid rebuilt every step, sized for the small bodies: cells are
+// twice the 95th-percentile radius, so two small bodies that touch are in the
+// same or adjacent cells. The few larger bodies (the Sun, grown survivors)
+// stay out of the grid; each scans the block of cells its own radius
+// reaches, and they are tested against each other directly. A single big
+// body therefore never widens every other body's search. Cells are hashed
+// into a table of linked lists, so the grid needs no bounds and costs O(N)
+// to build.
+class SpatialHash {
+public:
+    void build(const std::vector<Body>& bodies) {
+        size_t n = bodies.size(), size = 1;
+        radii.resize(n);
+        for (size_t i = 0; i < n; i++) radii[i] = bodies[i].radius;
+        small = 0;
+        if (n) {
+            size_t q = n * 95 / 100;
+            std::nth_element(radii.begin(), radii.begin() + q, radii.end());
+            small = radii[q];
+        }
+        cell = fmaxf(2 * small, 1e-3f);
+        while (size < 2 * n) size <<= 1;
+        heads.assign(size, -1);
+        next.assign(n, -1);
+        cx.resize(n);
+        cy.resize(n);
+        big.clear();
+        for (size_t i = 0; i < n; i++) {
+            cx[i] = cellOf(bodies[i].pos.x);
+            cy[i] = cellOf(bodies[i].pos.y);
+            if (bodies[i].radius > small) {
+                big.push_back(i);
+                continue;
+            }
+            size_t h = slot(cx[i], cy[i]);
+            next[i] = heads[h];
+            heads[h] = (int)i;
+        }
+    }
+
+    // Calls f(i, j) once for every i < j whose discs overlap.
+    template <class F>
+    void overlaps(const std::vector<Body>& bodies, F f) const {
+        auto test = [&](size_t i, size_t j) {
+            const Body& a = bodies[i];
+            const Body& b = bodies[j];
+            float ex = b.pos.x - a.pos.x, ey = b.pos.y - a.pos.y, rr = a.radius + b.radius;
+            if (ex * ex + ey * ey < rr * rr) f(std::min(i, j), std::max(i, j));
+        };
+        // Visits the grid bodies in the (2m+1)^2 cells around (x, y); the cell
+        // check skips chains that several cells share through the hash.
+        auto scan = [&](int x, int y, int m, auto visit) {
+            for (int dy = -m; dy <= m; dy++)
+                for (int dx = -m; dx <= m; dx++)
+                    for (int j = heads[slot(x + dx, y + dy)]; j >= 0; j = next[j])
+                        if (cx[j] == x + dx && cy[j] == y + dy) visit((size_t)j);
+        };
+        for (size_t i = 0; i < bodies.size(); i++) {
+            if (bodies[i].radius > small) continue;
+            scan(cx[i], cy[i], 1, [&](size_t j) { if (j > i) test(i, j); });
+        }
+        for (size_t k = 0; k < big.size(); k++) {
+            size_t i = big[k];
+            int m = (int)ceilf((bodies[i].radius + small) / cell);
+            scan(cx[i], cy[i], m, [&](size_t j) { test(i, j); });
+            for (size_t l = k + 1; l < big.size(); l++) test(i, big[l]);
         }
     }
+
+private:
+    int cellOf(float v) const { return (int)floorf(v / cell); }
+    size_t slot(int x, int y) const {
+        return ((unsigned)x * 73856093u ^ (unsigned)y * 19349663u) & (heads.size() - 1);
+    }
+
+    float cell = 1, small = 0;
+    std::vector<float> radii;
+    std::vector<int> heads, next, cx, cy;
+    std::vector<size_t> big;
 };
 
-int main() {
-    InitWindow(WIDTH, HEIGHT, "N-Body Gravity Simulator - Sun + Planets");
-    SetTargetFPS(60);
+static double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Positions before and after the latest physics step, so the renderer can
+// interpolate between them, and the wall-clock time `curr` was produced.
+// Bodies are listed by id because mergers remove them and grow the survivor.
+struct Frame {
+    std::vector<int> ids;
+    std::vector<Vector2> prev, curr;
+    std::vector<float> radius;
+    double stamp = 0;
+    unsigned long long step = 0;
+};
+
+// Lock-free triple buffer. The simulation fills the back slot and swaps it
+// with the middle one; the renderer swaps the middle slot with its front slot
+// only when a fresh frame is waiting. Neither side ever waits for the other.
+class TripleBuffer {
+public:
+    Frame& back() { return slots[backIdx]; }
+    void publish() { backIdx = middle.exchange(backIdx | Fresh) & 3; }
+    // True if a newer frame was taken; front() is valid either way.
+    bool acquire() {
+        if (!(middle.load() & Fresh)) return false;
+        frontIdx = middle.exchange(frontIdx) & 3;
+        return true;
+    }
+    const Frame& front() const { return slots[frontIdx]; }
+    // Before any thread starts: put the same frame in every slot.
+    void reset(const Frame& f) {
+        for (auto& s : slots) s = f;
+        middle = 2;
+    }
+
+private:
+    static const int Fresh = 4;
+    Frame slots[3];
+    int backIdx = 0, frontIdx = 1;
+    std::atomic<int> middle{2};
+};
+
+// Runs Body::update on its own thread with a fixed step, paced to wall-clock
+// time. Each published step is split into `substeps` updates. If a step takes
+// longer than real time, at most MaxCatchUp steps are run back to back before
+// the clock is reset, so the simulation slows down instead of spiralling.
+// With `merge` set, overlapping bodies merge after every update; the more
+// massive one keeps its id (and so its name, colour and trail).
+class Simulation {
+public:
+    // Owns a copy of the bodies; body k gets id k.
+    Simulation(const std::vector<Body>& b, float stepDt, int subs, bool merge)
+        : dt(stepDt), bodies(b), prevById(b.size()), substeps(subs), merging(merge) {
+        for (size_t k = 0; k < bodies.size(); k++) bodies[k].id = (int)k;
+        refreshPointers();
+        Frame& f = buffer.back();
+        f.stamp = now();
+        fill(f);
+        buffer.reset(f);
+    }
+    ~Simulation() { stop(); }
+
+    void start() { worker = std::thread([this] { loop(); }); }
+    void stop() {
+        running = false;
+        if (worker.joinable()) worker.join();
+    }
+
+    const float dt;
+    std::atomic<bool> paused{false};
+    std::atomic<unsigned long long> steps{0};
+    std::atomic<unsigned long long> mergers{0};
+    TripleBuffer buffer;
+
+    // One published step. Run by the worker thread, or called directly in
+    // headless mode where start() is never called.
+    void stepOnce() {
+        for (auto& b : bodies) prevById[b.id] = b.pos;
+        float h = dt / substeps;
+        for (int s = 0; s < substeps; s++) {
+            for (auto& body : bodies) body.update(h, ptrs);
+            if (merging) collide();
+        }
+        Frame& f = buffer.back();
+        fill(f);
+        f.stamp = now();
+        f.step = ++steps;
+        buffer.publish();
+    }
+    // Only safe to read while the worker thread is not running.
+    const std::vector<Body>& state() const { return bodies; }
+
+private:
+    static const int MaxCatchUp = 8;
+
+    void refreshPointers() {
+        ptrs.clear();
+        for (auto& body : bodies) ptrs.push_back(&body);
+    }
+
+    void fill(Frame& f) const {
+        size_t n = bodies.size();
+        f.ids.resize(n);
+        f.prev.resize(n);
+        f.curr.resize(n);
+        f.radius.resize(n);
+        for (size_t k = 0; k < n; k++) {
+            const Body& b = bodies[k];
+            f.ids[k] = b.id;
+            f.prev[k] = prevById[b.id];
+            f.curr[k] = b.pos;
+            f.radius[k] = b.radius;
+        }
+    }
+
+    // Merges every overlapping pair found by the hash. A body already absorbed
+    // this pass is skipped; its survivor is checked again next update.
+    void collide() {
+        grid.build(bodies);
+        pairs.clear();
+        grid.overlaps(bodies, [&](size_t i, size_t j) { pairs.emplace_back(i, j); });
+        if (pairs.empty()) return;
+
+        gone.assign(bodies.size(), 0);
+        for (auto [i, j] : pairs) {
+            if (gone[i] || gone[j]) continue;
+            Body& a = bodies[i];
+            Body& b = bodies[j];
+            bool keepA = a.mass > b.mass || (a.mass == b.mass && a.id < b.id);
+            Body& keep = keepA ? a : b;
+            Body& lose = keepA ? b : a;
+            float m = keep.mass + lose.mass;
+            keep.pos = {(keep.pos.x * keep.mass + lose.pos.x * lose.mass) / m,
+                        (keep.pos.y * keep.mass + lose.pos.y * lose.mass) / m};
+            keep.vel = {(keep.vel.x * keep.mass + lose.vel.x * lose.mass) / m,
+                        (keep.vel.y * keep.mass + lose.vel.y * lose.mass) / m};
+            keep.radius = cbrtf(keep.radius * keep.radius * keep.radius + lose.radius * lose.radius * lose.radius);
+            keep.mass = m;
+            gone[keepA ? j : i] = 1;
+            mergers++;
+        }
+        size_t w = 0;
+        for (size_t k = 0; k < bodies.size(); k++)
+            if (!gone[k]) bodies[w++] = std::move(bodies[k]);
+        bodies.erase(bodies.begin() + w, bodies.end());
+        refreshPointers();
+    }
+
+    void loop() {
+        double next = now();
+        while (running) {
+            if (paused) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                next = now();
+                continue;
+            }
+            int ran = 0;
+            while (now() >= next && ran < MaxCatchUp) {
+                stepOnce();
+                next += dt;
+                ran++;
+            }
+            if (ran == MaxCatchUp) next = now();
+            std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(next))));
+        }
+    }
 
+    std::vector<Body> bodies;
+    std::vector<Vector2> prevById;
+    std::vector<Body*> ptrs;
+    SpatialHash grid;
+    std::vector<std::pair<size_t, size_t>> pairs;
+    std::vector<char> gone;
+    int substeps;
+    const bool merging;
+    std::atomic<bool> running{true};
+    std::thread worker;
+};
+
+std::vector<Body> makeBodies(int disk) {
     std::vector<Body> bodies;
 
     bodies.emplace_back(Vector2{WIDTH/2.0f, HEIGHT/2.0f},
                         Vector2{0, 0},
                         30000.0f, 40, YELLOW, "Sun", false);
 
-    bodies.emplace_back(Vector2{WIDTH/2.0f + 120, HEIGHT/2.0f},
-                        Vector2{0, 90.0f},
-                        8.0f, 10, GRAY, "Mercury");
+    if (disk) {
+        // Planetesimals on circular orbits between 80 and 420 px, with a small
+        // random kick so neighbours cross paths and start to coalesce.
+        const Color palette[] = {GRAY, LIGHTGRAY, ORANGE, SKYBLUE, VIOLET};
+        for (int i = 0; i < disk; i++) {
+            float r = 80.0f + GetRandomValue(0, 10000) / 10000.0f * 340.0f;
+            float a = GetRandomValue(0, 36000) / 36000.0f * 2 * PI;
+            float v = sqrtf(4000.0f * bodies[0].mass / r) * (1.0f + GetRandomValue(-300, 300) / 10000.0f);
+            bodies.emplace_back(Vector2{WIDTH/2.0f + r * cosf(a), HEIGHT/2.0f + r * sinf(a)},
+                                Vector2{-v * sinf(a), v * cosf(a)},
+                                0.05f, 2, palette[i % 5], "", false);
+        }
+    } else {
+        bodies.emplace_back(Vector2{WIDTH/2.0f + 120, HEIGHT/2.0f},
+                            Vector2{0, 90.0f},
+                            8.0f, 10, GRAY, "Mercury");
+
+        bodies.emplace_back(Vector2{WIDTH/2.0f + 200, HEIGHT/2.0f},
+                            Vector2{0, 65.0f},
+                            15.0f, 16, ORANGE, "Venus");
+
+        bodies.emplace_back(Vector2{WIDTH/2.0f + 300, HEIGHT/2.0f},
+                            Vector2{0, 55.0f},
+                            18.0f, 16, BLUE, "Earth");
+
+        bodies.emplace_back(Vector2{WIDTH/2.0f + 420, HEIGHT/2.0f},
+                            Vector2{0, 42.0f},
+                            10.0f, 12, RED, "Mars");
+    }
+
+    return bodies;
+}
+
+// Runs the simulation without a window as fast as the CPU allows, writing
+// every body's state after each step to a CSV file.
+int runHeadless(const std::vector<Body>& bodies, float dt, int substeps, bool merge, int steps, const char* out) {
+    FILE* f = fopen(out, "w");
+    if (!f) {
+        fprintf(stderr, "cannot write %s\n", out);
+        return 1;
+    }
+    fprintf(f, "step,t,id,name,x,y,vx,vy,mass,radius\n");
+    Simulation sim(bodies, dt, substeps, merge);
+    double compute = 0;
+    for (int s = 1; s <= steps; s++) {
+        double t0 = now();
+        sim.stepOnce();
+        compute += now() - t0;
+        for (const auto& b : sim.state())
+            fprintf(f, "%d,%.6f,%d,%s,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n", s, s * dt, b.id, b.name.c_str(),
+                    b.pos.x, b.pos.y, b.vel.x, b.vel.y, b.mass, b.radius);
+    }
+    fclose(f);
+    printf("%d steps, %zu -> %zu bodies, %llu mergers\n", steps, bodies.size(), sim.state().size(), sim.mergers.load());
+    printf("wall time per step: %.4f ms\n", steps ? compute / steps * 1e3 : 0.0);
+    printf("wrote %s\n", out);
+    return 0;
+}
 
-    bodies.emplace_back(Vector2{WIDTH/2.0f + 200, HEIGHT/2.0f},
-                        Vector2{0, 65.0f},
-                        15.0f, 16, ORANGE, "Venus");
+int main(int argc, char** argv) {
+    float physicsDt = 1.0f / 120.0f;
+    int substeps = 1;
+    int disk = 0;
+    bool merge = false;
+    bool headless = false;
+    int steps = 1000;
+    char out[256] = "orbits.csv";
+    for (int i = 1; i < argc; i++) {
+        if (sscanf(argv[i], "--dt=%f", &physicsDt) == 1) continue;
+        if (sscanf(argv[i], "--substeps=%d", &substeps) == 1) continue;
+        if (sscanf(argv[i], "--disk=%d", &disk) == 1) continue;
+        if (sscanf(argv[i], "--steps=%d", &steps) == 1) continue;
+        if (sscanf(argv[i], "--out=%255s", out) == 1) continue;
+        if (std::string(argv[i]) == "--headless") { headless = true; continue; }
+        if (std::string(argv[i]) == "--merge") { merge = true; continue; }
+        fprintf(stderr, "usage: %s [--dt=SECONDS] [--substeps=N] [--disk=N] [--merge] [--headless --steps=N --out=FILE]\n", argv[0]);
+        return 1;
+    }
+    if (physicsDt <= 0 || substeps < 1 || disk < 0) {
+        fprintf(stderr, "--dt must be > 0, --substeps >= 1 and --disk >= 0\n");
+        return 1;
+    }
 
-    bodies.emplace_back(Vector2{WIDTH/2.0f + 300, HEIGHT/2.0f},
-                        Vector2{0, 55.0f},
-                        18.0f, 16, BLUE, "Earth");
+    // Mergers are for the accretion disk; the planet demo keeps its bodies
+    // unless --merge asks for them.
+    merge = merge || disk > 0;
+    std::vector<Body> bodies = makeBodies(disk);
+    if (headless) return runHeadless(bodies, physicsDt, substeps, merge, steps, out);
 
-    bodies.emplace_back(Vector2{WIDTH/2.0f + 420, HEIGHT/2.0f},
-                        Vector2{0, 42.0f},
-                        10.0f, 12, RED, "Mars");
+    InitWindow(WIDTH, HEIGHT, disk ? "N-Body Gravity Simulator - Accretion Disk"
+                                   : "N-Body Gravity Simulator - Sun + Planets");
+    SetTargetFPS(60);
+    // Trails belong to the renderer: one point per drawn frame, as before.
+    // Both trails and `bodies` (name, colour) are indexed by body id; the
+    // simulation works on its own copy.
+    TrailStore trails(bodies.size());
+    std::vector<Vector2> drawPos;
 
-    std::vector<Body*> bodyPtrs;
-    for (auto& b : bodies) bodyPtrs.push_back(&b);
+    Simulation sim(bodies, physicsDt, substeps, merge);
+    sim.start();
 
     bool paused = false;
 
     while (!WindowShouldClose()) {
-        float dt = GetFrameTime();
-
-        if (IsKeyPressed(KEY_SPACE)) paused = !paused;
+        if (IsKeyPressed(KEY_SPACE)) {
+            paused = !paused;
+            sim.paused = paused;
+        }
         if (IsKeyPressed(KEY_R)) {
-            for (auto& b : bodies) {
-                if (b.drawTrail) b.trail.clear();
-            }
+            trails.clear();
         }
 
-        if (!paused) {
-            for (auto& body : bodies) {
-                body.update(dt, bodyPtrs);
-            }
+        sim.buffer.acquire();
+        const Frame& f = sim.buffer.front();
+        float alpha = paused ? 1.0f : fminf(1.0f, fmaxf(0.0f, (float)((now() - f.stamp) / sim.dt)));
+        drawPos.resize(f.ids.size());
+        for (size_t k = 0; k < f.ids.size(); k++) {
+            drawPos[k] = {f.prev[k].x + (f.curr[k].x - f.prev[k].x) * alpha,
+                          f.prev[k].y + (f.curr[k].y - f.prev[k].y) * alpha};
+            if (!paused && bodies[f.ids[k]].drawTrail) trails.push(f.ids[k], drawPos[k]);
         }
 
         BeginDrawing();
@@ -121,17 +501,23 @@ int main() {
             DrawPixel(x, y, WHITE);
         }
 
-        for (const auto& body : bodies) {
-            body.draw();
+        for (size_t k = 0; k < f.ids.size(); k++) {
+            const Body& b = bodies[f.ids[k]];
+            if (b.drawTrail) trails.draw(f.ids[k], b.color);
+            b.draw(drawPos[k], f.radius[k]);
         }
 
         DrawText("SPACE - Pause / Resume", 10, 10, 20, LIME);
         DrawText("R - Reset trails", 10, 40, 20, LIME);
+        DrawText(TextFormat("physics dt %.4f s x%d | step %llu | %d FPS", sim.dt, substeps, f.step, GetFPS()),
+                 10, 70, 20, LIME);
+        DrawText(TextFormat("%d bodies | %llu mergers", (int)f.ids.size(), sim.mergers.load()), 10, 100, 20, LIME);
         DrawText(paused ? "PAUSED" : "RUNNING", WIDTH - 150, 10, 24, paused ? RED : GREEN);
 
         EndDrawing();
     }
 
+    sim.stop();
     CloseWindow();
     return 0;
-}
\ No newline at end of file
+}
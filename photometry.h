@@ -0,0 +1,183 @@
+#pragma once
+// Blackbody colours and synthetic photometry shared by the raylib tools.
+// Everything is tabulated once, on first use, on a log T grid (1000 K -
+// 100000 K); lookups are O(1) linear interpolation.
+#include <raylib.h>
+#include <cmath>
+#include <algorithm>
+
+const double PLANCK_H = 6.62607015e-34;
+const double LIGHT_C = 2.99792458e8;
+const double BOLTZMANN_K = 1.380649e-23;
+const double STEFAN_SIGMA = 5.670374419e-8;
+const double RAD_C1 = 2.0 * PLANCK_H * LIGHT_C * LIGHT_C;   // 2hc^2
+const double RAD_C2 = PLANCK_H * LIGHT_C / BOLTZMANN_K;     // hc/k
+
+// Spectral radiance B_lambda(T) in W / (m^2 sr m). Evaluated in double: in
+// float, lambda^5 underflows below ~20 nm and exp(hc/lambda k T) overflows
+// once the exponent passes ~88 (cool stars in the blue). expm1 keeps the
+// Rayleigh-Jeans end accurate; past the Wien cutoff the result is 0.
+inline double planck(double wavelength, double temp) {
+    double l2 = wavelength * wavelength;
+    double x = RAD_C2 / (wavelength * temp);
+    return RAD_C1 / (l2 * l2 * wavelength) / std::expm1(x);
+}
+
+// Johnson UBV and Gaia-like G, BP, RP.
+enum Band { BandU, BandB, BandV, BandG, BandBP, BandRP, NumBands };
+
+inline const char* bandName(Band b) {
+    static const char* names[NumBands] = {"U", "B", "V", "G", "BP", "RP"};
+    return names[b];
+}
+
+class Photometry {
+public:
+    static const int TempNodes = 1024;
+    static constexpr float LogTMin = 3.0f, LogTMax = 5.0f;
+
+    static const Photometry& get() {
+        static const Photometry table;
+        return table;
+    }
+
+    // Colour of a blackbody at `temp`, normalised to its brightest channel.
+    Color color(float temp) const { return colorLog(log10f(std::max(temp, 1.0f))); }
+
+    // Same, from log10 T, for callers that store temperatures as logs.
+    Color colorLog(float logTemp) const {
+        float f;
+        int i = nodeLog(logTemp, f);
+        const unsigned char* a = rgb[i];
+        const unsigned char* b = rgb[i + 1];
+        return {(unsigned char)(a[0] + (b[0] - a[0]) * f + 0.5f),
+                (unsigned char)(a[1] + (b[1] - a[1]) * f + 0.5f),
+                (unsigned char)(a[2] + (b[2] - a[2]) * f + 0.5f), 255};
+    }
+
+    // Bolometric correction BC_X = M_bol - M_X. Zero points: all colours are 0
+    // at 10000 K (roughly Vega) and BC_V(5772 K) = -0.07.
+    float bc(Band band, float temp) const {
+        float f;
+        int i = node(temp, f);
+        return bcTable[band][i] + (bcTable[band][i + 1] - bcTable[band][i]) * f;
+    }
+
+    // Absolute magnitude in `band` of a blackbody star with luminosity L/Lsun.
+    float absMag(Band band, float temp, float lum) const {
+        return 4.74f - 2.5f * log10f(lum) - bc(band, temp);
+    }
+
+    float colorIndex(Band a, Band b, float temp) const { return bc(b, temp) - bc(a, temp); }
+
+    void colors(const float* temps, Color* out, size_t n) const {
+        for (size_t k = 0; k < n; k++) out[k] = color(temps[k]);
+    }
+
+    // Hue of monochromatic light, 380-780 nm; outside that range the colour
+    // of the nearest end is used so plotted spectra stay visible.
+    Color wavelengthColor(float nm) const {
+        int i = (int)std::min(400.0f, std::max(0.0f, nm - 380.0f) + 0.5f);
+        return lineRGB[i];
+    }
+
+private:
+    unsigned char rgb[TempNodes][3];
+    float bcTable[NumBands][TempNodes];
+    Color lineRGB[401];
+
+    static int node(float temp, float& frac) { return nodeLog(log10f(std::max(temp, 1.0f)), frac); }
+    static int nodeLog(float logTemp, float& frac) {
+        float x = (logTemp - LogTMin) * ((TempNodes - 1) / (LogTMax - LogTMin));
+        x = std::min((float)(TempNodes - 1) - 1e-3f, std::max(0.0f, x));
+        int i = (int)x;
+        frac = x - i;
+        return i;
+    }
+
+    static double lobe(double x, double mu, double s1, double s2) {
+        double t = (x - mu) / (x < mu ? s1 : s2);
+        return exp(-0.5 * t * t);
+    }
+    // CIE 1931 2-degree matching functions, multi-lobe fit of Wyman, Sloan and
+    // Shirley (2013); good to a few percent, plenty for display colour.
+    static void cie(double nm, double& x, double& y, double& z) {
+        x = 1.056 * lobe(nm, 599.8, 37.9, 31.0) + 0.362 * lobe(nm, 442.0, 16.0, 26.7) - 0.065 * lobe(nm, 501.1, 20.4, 26.2);
+        y = 0.821 * lobe(nm, 568.8, 46.9, 40.5) + 0.286 * lobe(nm, 530.9, 16.3, 31.1);
+        z = 1.217 * lobe(nm, 437.0, 11.8, 36.0) + 0.681 * lobe(nm, 459.0, 26.0, 13.8);
+    }
+    // Gaussian stand-ins for the passbands: centre and FWHM in nm.
+    static double response(Band b, double nm) {
+        static const double centre[NumBands] = {365, 445, 551, 673, 532, 797};
+        static const double fwhm[NumBands] = {66, 94, 88, 440, 253, 296};
+        double t = (nm - centre[b]) / (fwhm[b] / 2.3548);
+        return exp(-0.5 * t * t);
+    }
+
+    static Color toSRGB(double X, double Y, double Z) {
+        double c[3] = {3.2406 * X - 1.5372 * Y - 0.4986 * Z,
+                       -0.9689 * X + 1.8758 * Y + 0.0415 * Z,
+                       0.0557 * X - 0.2040 * Y + 1.0570 * Z};
+        double m = std::max(c[0], std::max(c[1], c[2]));
+        unsigned char o[3];
+        for (int k = 0; k < 3; k++) {
+            double v = m > 0 ? std::max(0.0, c[k] / m) : 0;
+            v = v <= 0.0031308 ? 12.92 * v : 1.055 * pow(v, 1 / 2.4) - 0.055;
+            o[k] = (unsigned char)(v * 255 + 0.5);
+        }
+        return {o[0], o[1], o[2], 255};
+    }
+
+    // Photon-counting band fluxes, 1 nm steps over 300-1100 nm.
+    static void bandFluxes(double temp, double* flux, double& X, double& Y, double& Z) {
+        std::fill(flux, flux + NumBands, 0.0);
+        X = Y = Z = 0;
+        for (int nm = 300; nm <= 1100; nm++) {
+            double b = planck(nm * 1e-9, temp);
+            for (int k = 0; k < NumBands; k++) flux[k] += b * nm * response((Band)k, nm);
+            if (nm >= 360 && nm <= 830) {
+                double x, y, z;
+                cie(nm, x, y, z);
+                X += b * x;
+                Y += b * y;
+                Z += b * z;
+            }
+        }
+    }
+
+    Photometry() {
+        double flux[NumBands], X, Y, Z;
+        double raw[NumBands][TempNodes];
+        for (int i = 0; i < TempNodes; i++) {
+            double temp = pow(10.0, LogTMin + (LogTMax - LogTMin) * i / (TempNodes - 1));
+            bandFluxes(temp, flux, X, Y, Z);
+            Color c = toSRGB(X, Y, Z);
+            rgb[i][0] = c.r;
+            rgb[i][1] = c.g;
+            rgb[i][2] = c.b;
+            double bol = STEFAN_SIGMA * pow(temp, 4) / PI;
+            for (int k = 0; k < NumBands; k++) raw[k][i] = -2.5 * log10(bol / flux[k]);
+        }
+
+        double vega[NumBands];
+        bandFluxes(10000, vega, X, Y, Z);
+        double sun[NumBands];
+        bandFluxes(5772, sun, X, Y, Z);
+        double bcV10000 = -2.5 * log10(STEFAN_SIGMA * 1e16 / PI / vega[BandV]);
+        double zpV = -0.07 + 2.5 * log10(STEFAN_SIGMA * pow(5772.0, 4) / PI / sun[BandV]);
+        for (int k = 0; k < NumBands; k++) {
+            // Shift each band so BC_X(10000 K) equals BC_V(10000 K).
+            double bcX10000 = -2.5 * log10(STEFAN_SIGMA * 1e16 / PI / vega[k]);
+            double zp = zpV + bcV10000 - bcX10000;
+            for (int i = 0; i < TempNodes; i++) bcTable[k][i] = (float)(raw[k][i] + zp);
+        }
+
+        for (int i = 0; i <= 400; i++) {
+            double x, y, z;
+            cie(380 + i, x, y, z);
+            lineRGB[i] = toSRGB(x, y, z);
+        }
+    }
+};
+
+inline Color blackbodyColor(float temp) { return Photometry::get().color(temp); }
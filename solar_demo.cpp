@@ -2,6 +2,9 @@
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdio>
+#include <chrono>
+#include "photometry.h"
 
 const int WIDTH = 1200;
 const int HEIGHT = 800;
@@ -32,13 +35,7 @@ struct Star : public Body {
     }
 
     void updateColor() {
-        float peak = 2898000.0f / temp;          // Wien's law in nm (approx constant)
-
-        if (peak < 400)      col = BLUE;
-        else if (peak < 500) col = WHITE;
-        else if (peak < 600) col = YELLOW;
-        else if (peak < 700) col = ORANGE;
-        else                 col = RED;
+        col = blackbodyColor(temp);
     }
 };
 
@@ -63,19 +60,67 @@ struct Planet : public Body {
     }
 };
 
-int main() {
+std::vector<Planet> makePlanets(Vector2 center) {
+    std::vector<Planet> planets;
+    planets.emplace_back(center, 100, 0.04f, 10, GRAY,   "Mercury");
+    planets.emplace_back(center, 180, 0.025f, 15, YELLOW,"Venus");
+    planets.emplace_back(center, 260, 0.018f, 15, BLUE,   "Earth");
+    planets.emplace_back(center, 360, 0.012f, 12, RED,    "Mars");
+    return planets;
+}
+
+// Steps the planets at a fixed dt without a window and logs every position.
+int runHeadless(float temp, int steps, float dt, const char* out) {
+    FILE* f = fopen(out, "w");
+    if (!f) {
+        fprintf(stderr, "cannot write %s\n", out);
+        return 1;
+    }
+    Vector2 center = { float(WIDTH / 2), float(HEIGHT / 2) };
+    Star sun(center, 50, temp);
+    std::vector<Planet> planets = makePlanets(center);
+
+    fprintf(f, "step,t,name,x,y,angle\n");
+    double busy = 0;
+    for (int s = 1; s <= steps; ++s) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (auto& p : planets) p.update(dt);
+        sun.updateColor();
+        busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        for (const auto& p : planets)
+            fprintf(f, "%d,%.6f,%s,%.3f,%.3f,%.6f\n", s, s * dt, p.label.c_str(), p.pos.x, p.pos.y, p.angle);
+    }
+    fclose(f);
+    printf("%d steps, star %.0f K, wall time per step %.4f ms, wrote %s\n",
+           steps, sun.temp, steps ? busy / steps * 1e3 : 0.0, out);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    float temp = 5772;
+    bool headless = false;
+    int steps = 600;
+    float dt = 1 / 60.0f;
+    char out[256] = "orbits.csv";
+    for (int i = 1; i < argc; ++i) {
+        if (sscanf(argv[i], "--temp=%f", &temp) == 1) continue;
+        if (sscanf(argv[i], "--steps=%d", &steps) == 1) continue;
+        if (sscanf(argv[i], "--dt=%f", &dt) == 1) continue;
+        if (sscanf(argv[i], "--out=%255s", out) == 1) continue;
+        if (std::string(argv[i]) == "--headless") { headless = true; continue; }
+        fprintf(stderr, "usage: %s [--temp=K] [--headless --steps=N --dt=S --out=FILE]\n", argv[0]);
+        return 1;
+    }
+    if (headless) return runHeadless(temp, steps, dt, out);
+
     InitWindow(WIDTH, HEIGHT, "Solar System - Blackbody Demo");
     SetTargetFPS(60);
 
     Vector2 center = { float(WIDTH / 2), float(HEIGHT / 2) };
 
-    Star sun(center, 50, 5772);
+    Star sun(center, 50, temp);
 
-    std::vector<Planet> planets;
-    planets.emplace_back(center, 100, 0.04f, 10, GRAY,   "Mercury");
-    planets.emplace_back(center, 180, 0.025f, 15, YELLOW,"Venus");
-    planets.emplace_back(center, 260, 0.018f, 15, BLUE,   "Earth");
-    planets.emplace_back(center, 360, 0.012f, 12, RED,    "Mars");
+    std::vector<Planet> planets = makePlanets(center);
 
     while (!WindowShouldClose()) {
         float delta = GetFrameTime();
@@ -2,37 +2,410 @@
 #include <cmath>
 #include <vector>
 #include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 using namespace std;
 struct State {
     double theta, phi;
 };
 
+// theta^n is taken as 0 once theta goes negative: trial stages of the step
+// that crosses the surface may overshoot, and pow() of a negative base with a
+// fractional n is NaN.
 State deriv(double xi, State s, double n) {
-    if (xi == 0) return {0, 0};
-    return {s.phi, -pow(s.theta, n) - (2.0 / xi) * s.phi};
+    if (xi == 0) return {0, -1.0 / 3};
+    double t = s.theta > 0 ? pow(s.theta, n) : (n == 0 ? 1 : 0);
+    return {s.phi, -t - (2.0 / xi) * s.phi};
 }
-void solve(double n, double h = 0.01) {
-    double xi = 1e-10;
-    State s = {1.0, 0.0};
+
+// Power series about the centre, used to step off the singular point.
+State series(double xi, double n) {
+    double x2 = xi * xi, c6 = n * (8 * n - 5) / 15120;
+    return {1 - x2 / 6 + n * x2 * x2 / 120 - c6 * x2 * x2 * x2,
+            xi * (-1.0 / 3 + n * x2 / 30 - 6 * c6 * x2 * x2)};
+}
+
+const double XiStart = 0.01;
+
+// One accepted Dormand-Prince step, kept for dense output: y(xi + s h) =
+// y + h * sum_j q[j] s^(j+1).
+struct Step {
+    double xi, h;
+    State y;
+    State q[4];
+
+    State at(double s) const {
+        double p = s, th = 0, ph = 0;
+        for (int j = 0; j < 4; j++, p *= s) {
+            th += q[j].theta * p;
+            ph += q[j].phi * p;
+        }
+        return {y.theta + h * th, y.phi + h * ph};
+    }
+};
+
+// Solution for one index: accepted steps out to the surface xi1, where
+// theta = 0 and dtheta = theta'(xi1).
+struct Polytrope {
+    double n = 0, xi1 = 0, dtheta = 0;
+    vector<Step> steps;
+    size_t rejected = 0;
+
+    State at(double xi) const {
+        if (xi <= XiStart) return series(xi, n);
+        size_t k = upper_bound(steps.begin(), steps.end(), xi, [](double v, const Step& s) { return v < s.xi; }) -
+                   steps.begin();
+        const Step& s = steps[k ? k - 1 : 0];
+        return s.at(min(1.0, (xi - s.xi) / s.h));
+    }
+};
+
+// Dormand-Prince 5(4) with the standard 4th-order continuous extension.
+// The step that takes theta through zero is kept, and the surface is located
+// on its dense output by safeguarded Newton (theta' = phi comes from the same
+// interpolant).
+Polytrope integrate(double n, double tol = 1e-12, double xiMax = 1e6) {
+    static const double c[7] = {0, 1.0 / 5, 3.0 / 10, 4.0 / 5, 8.0 / 9, 1, 1};
+    static const double A[7][6] = {
+        {0},
+        {1.0 / 5},
+        {3.0 / 40, 9.0 / 40},
+        {44.0 / 45, -56.0 / 15, 32.0 / 9},
+        {19372.0 / 6561, -25360.0 / 2187, 64448.0 / 6561, -212.0 / 729},
+        {9017.0 / 3168, -355.0 / 33, 46732.0 / 5247, 49.0 / 176, -5103.0 / 18656},
+        {35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84}};
+    static const double E[7] = {-71.0 / 57600, 0, 71.0 / 16695, -71.0 / 1920, 17253.0 / 339200, -22.0 / 525, 1.0 / 40};
+    static const double P[7][4] = {
+        {1, -8048581381.0 / 2820520608, 8663915743.0 / 2820520608, -12715105075.0 / 11282082432},
+        {0, 0, 0, 0},
+        {0, 131558114200.0 / 32700410799, -68118460800.0 / 10900136933, 87487479700.0 / 32700410799},
+        {0, -1754552775.0 / 470086768, 14199869525.0 / 1410260304, -10690763975.0 / 1880347072},
+        {0, 127303824393.0 / 49829197408, -318862633887.0 / 49829197408, 701980252875.0 / 199316789632},
+        {0, -282668133.0 / 205662961, 2019193451.0 / 616988883, -1453857185.0 / 822651844},
+        {0, 40617522.0 / 29380423, -110615467.0 / 29380423, 69997945.0 / 29380423}};
+
+    Polytrope p;
+    p.n = n;
+    double xi = XiStart, h = 0.01;
+    State y = series(xi, n), k[7];
+    k[0] = deriv(xi, y, n);
+    while (xi < xiMax) {
+        for (int s = 1; s < 7; s++) {
+            State t = y;
+            for (int j = 0; j < s; j++) {
+                t.theta += h * A[s][j] * k[j].theta;
+                t.phi += h * A[s][j] * k[j].phi;
+            }
+            k[s] = deriv(xi + c[s] * h, t, n);
+        }
+        State y1 = y;
+        for (int j = 0; j < 6; j++) {
+            y1.theta += h * A[6][j] * k[j].theta;
+            y1.phi += h * A[6][j] * k[j].phi;
+        }
+        double et = 0, ep = 0;
+        for (int j = 0; j < 7; j++) {
+            et += h * E[j] * k[j].theta;
+            ep += h * E[j] * k[j].phi;
+        }
+        double st = tol * (1 + max(fabs(y.theta), fabs(y1.theta)));
+        double sp = tol * (1 + max(fabs(y.phi), fabs(y1.phi)));
+        double err = sqrt(0.5 * ((et / st) * (et / st) + (ep / sp) * (ep / sp)));
+        if (!(err <= 1)) {
+            h *= max(0.2, 0.9 * pow(err, -0.2));
+            p.rejected++;
+            continue;
+        }
+
+        Step step = {xi, h, y, {}};
+        for (int m = 0; m < 4; m++)
+            for (int j = 0; j < 7; j++) {
+                step.q[m].theta += k[j].theta * P[j][m];
+                step.q[m].phi += k[j].phi * P[j][m];
+            }
+        p.steps.push_back(step);
+
+        if (y1.theta <= 0) {
+            double lo = 0, hi = 1, s = y.theta / (y.theta - y1.theta);
+            for (int it = 0; it < 100 && hi - lo > 1e-15; it++) {
+                State v = step.at(s);
+                if (v.theta > 0) lo = s;
+                else hi = s;
+                double ns = s - v.theta / (h * v.phi);
+                s = ns > lo && ns < hi ? ns : 0.5 * (lo + hi);
+            }
+            p.xi1 = xi + s * h;
+            p.dtheta = step.at(s).phi;
+            return p;
+        }
+
+        xi += h;
+        y = y1;
+        k[0] = k[6];
+        h *= min(10.0, 0.9 * pow(max(err, 1e-10), -0.2));
+    }
+    p.xi1 = INFINITY;
+    return p;
+}
+
+// Structure constants of a polytrope of index n (Chandrasekhar's notation).
+struct PolyConstants {
+    double n, xi1, dtheta1;
+    double omega;       // -xi1^2 theta'(xi1):  M = 4 pi alpha^3 rho_c omega
+    double dn;          // rho_c / rho_mean = -xi1 / (3 theta'(xi1))
+    double wn;          // P_c = W_n G M^2 / R^4
+    double bind;        // Omega = -bind G M^2 / R, bind = 3 / (5 - n)
+};
+
+PolyConstants constantsOf(const Polytrope& p) {
+    double d = p.dtheta;
+    return {p.n, p.xi1, d, -p.xi1 * p.xi1 * d, -p.xi1 / (3 * d), 1 / (4 * M_PI * (p.n + 1) * d * d), 3 / (5 - p.n)};
+}
+
+// Binary table: header, then one record per index of PolyConstants followed
+// by theta and phi at `points` values of x = xi / xi1 spaced evenly on [0, 1].
+struct TableHeader {
+    char magic[8];          // "POLYTROP"
+    uint32_t version;       // 1
+    uint32_t points;
+    uint64_t count;
+    double nMin, dn;
+};
+
+const size_t ConstDoubles = sizeof(PolyConstants) / sizeof(double);
+
+// Reads a table written by buildTable() and interpolates it: 4-point
+// Lagrange in n (xi1 in log, since it diverges as n -> 5), cubic Hermite in x
+// (phi is theta's derivative, so it supplies the slopes).
+class PolytropeTable {
+public:
+    bool load(const string& path) {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) return false;
+        bool ok = fread(&h, sizeof h, 1, f) == 1 && !memcmp(h.magic, "POLYTROP", 8) && h.version == 1;
+        // The header must describe exactly the rest of the file, with enough
+        // indices for the 4-point stencil and points for a Hermite interval.
+        long bytes = ok && fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+        ok = ok && bytes >= (long)sizeof h && fseek(f, sizeof h, SEEK_SET) == 0 && h.count >= 4 &&
+             h.points >= 2 && h.dn > 0;
+        if (ok) {
+            uint64_t doubles = (bytes - sizeof h) / sizeof(double);
+            ok = (bytes - sizeof h) % sizeof(double) == 0 && h.points <= doubles && doubles % record() == 0 &&
+                 h.count == doubles / record();
+        }
+        if (ok) {
+            data.resize(h.count * record());
+            ok = fread(data.data(), sizeof(double), data.size(), f) == data.size();
+        }
+        fclose(f);
+        if (!ok) fprintf(stderr, "%s is not a valid polytrope table\n", path.c_str());
+        return ok;
+    }
+
+    size_t count() const { return h.count; }
+    bool finite() const {
+        return all_of(data.begin(), data.end(), [](double v) { return std::isfinite(v); });
+    }
+    const PolyConstants& constants(size_t i) const { return *(const PolyConstants*)&data[i * record()]; }
+
+    // theta and dtheta/dxi at fractional radius x of the index-n polytrope.
+    State at(double n, double x) const {
+        double w[4];
+        size_t i = stencil(n, w);
+        State s = {0, 0};
+        for (int k = 0; k < 4; k++) {
+            State r = row(i + k, x);
+            s.theta += w[k] * r.theta;
+            s.phi += w[k] * r.phi;
+        }
+        return s;
+    }
+
+    double xi1(double n) const {
+        double w[4], l = 0;
+        size_t i = stencil(n, w);
+        for (int k = 0; k < 4; k++) l += w[k] * log(constants(i + k).xi1);
+        return exp(l);
+    }
+
+private:
+    size_t record() const { return ConstDoubles + 2 * h.points; }
+
+    // First of the four nodes around n (needs count >= 4) and their weights.
+    size_t stencil(double n, double* w) const {
+        double u = min((double)h.count - 1, max(0.0, (n - h.nMin) / h.dn));
+        size_t i = min((size_t)max(0.0, floor(u) - 1), h.count - 4);
+        double f = u - i;
+        w[0] = -(f - 1) * (f - 2) * (f - 3) / 6;
+        w[1] = f * (f - 2) * (f - 3) / 2;
+        w[2] = -f * (f - 1) * (f - 3) / 2;
+        w[3] = f * (f - 1) * (f - 2) / 6;
+        return i;
+    }
+
+    State row(size_t i, double x) const {
+        const double* r = &data[i * record()];
+        const double* th = r + ConstDoubles;
+        const double* ph = th + h.points;
+        double xi1 = r[1], dx = 1.0 / (h.points - 1);
+        double u = min((double)h.points - 1, max(0.0, x / dx));
+        size_t j = min((size_t)u, (size_t)h.points - 2);
+        double s = u - j, s2 = s * s, s3 = s2 * s, hx = dx * xi1;
+        double h00 = 2 * s3 - 3 * s2 + 1, h10 = s3 - 2 * s2 + s, h01 = -2 * s3 + 3 * s2, h11 = s3 - s2;
+        double theta = h00 * th[j] + h10 * hx * ph[j] + h01 * th[j + 1] + h11 * hx * ph[j + 1];
+        return {theta, ph[j] + (ph[j + 1] - ph[j]) * s};
+    }
+
+    TableHeader h = {};
+    vector<double> data;
+};
+
+// Integrates indices nMin, nMin + dn, ... (count of them) on `threads`
+// threads and writes the table to `path`.
+int buildTable(double nMin, double dn, size_t count, uint32_t points, double tol, int threads, const string& path) {
+    size_t rec = ConstDoubles + 2 * points;
+    vector<double> data(count * rec);
+    atomic<size_t> next{0}, steps{0}, rejected{0};
+    auto t0 = chrono::steady_clock::now();
+    auto work = [&]() {
+        for (size_t i; (i = next++) < count;) {
+            Polytrope p = integrate(nMin + i * dn, tol);
+            steps += p.steps.size();
+            rejected += p.rejected;
+            double* r = &data[i * rec];
+            PolyConstants pc = constantsOf(p);
+            memcpy(r, &pc, sizeof pc);
+            for (uint32_t j = 0; j < points; j++) {
+                State s = j + 1 == points ? State{0, p.dtheta} : p.at(p.xi1 * j / (points - 1));
+                r[ConstDoubles + j] = s.theta;
+                r[ConstDoubles + points + j] = s.phi;
+            }
+        }
+    };
+    vector<thread> pool;
+    for (int t = 1; t < threads; t++) pool.emplace_back(work);
+    work();
+    for (auto& t : pool) t.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) {
+        fprintf(stderr, "cannot write %s\n", tmp.c_str());
+        return 1;
+    }
+    TableHeader h = {};
+    memcpy(h.magic, "POLYTROP", 8);
+    h.version = 1;
+    h.points = points;
+    h.count = count;
+    h.nMin = nMin;
+    h.dn = dn;
+    bool ok = fwrite(&h, sizeof h, 1, f) == 1 && fwrite(data.data(), sizeof(double), data.size(), f) == data.size();
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        fprintf(stderr, "cannot write %s\n", path.c_str());
+        return 1;
+    }
+    printf("%zu indices (n = %.3f .. %.3f), %u points each, %d threads: %.3f s, %.0f models/s\n", count, nMin,
+           nMin + (count - 1) * dn, points, threads, secs, count / secs);
+    printf("%zu accepted steps (%.0f per model), %zu rejected; wrote %s (%.1f MB)\n", (size_t)steps,
+           (double)steps / count, (size_t)rejected, path.c_str(), (sizeof h + data.size() * 8) / 1e6);
+    return 0;
+}
+
+// Table lookups against fresh integrations at indices between grid nodes.
+int checkTable(const string& path) {
+    PolytropeTable t;
+    if (!t.load(path)) return 1;
+    double worst = 0, worstXi = 0;
+    size_t probes = 0;
+    auto t0 = chrono::steady_clock::now();
+    for (size_t i = 0; i + 1 < t.count(); i += max<size_t>(1, t.count() / 40)) {
+        double n = 0.5 * (t.constants(i).n + t.constants(i + 1).n);
+        Polytrope p = integrate(n);
+        // Written so a NaN error sticks instead of being dropped by max().
+        double errXi = fabs(t.xi1(n) - p.xi1) / p.xi1;
+        if (!(errXi <= worstXi)) worstXi = errXi;
+        for (int j = 0; j <= 200; j++) {
+            double x = j / 200.0;
+            double err = fabs(t.at(n, x).theta - p.at(min(x * p.xi1, p.xi1)).theta);
+            if (!(err <= worst)) worst = err;
+            probes++;
+        }
+    }
+    printf("%s: %zu indices; %zu probes between nodes, max |theta| error %.1e, max xi1 rel error %.1e\n",
+           path.c_str(), t.count(), probes, worst, worstXi);
+    if (!std::isfinite(worst) || !std::isfinite(worstXi) || !t.finite()) {
+        fprintf(stderr, "%s: table holds non-finite values\n", path.c_str());
+        return 1;
+    }
+    const int lookups = 10000000;
+    double sum = 0;
+    t0 = chrono::steady_clock::now();
+    for (int k = 0; k < lookups; k++) sum += t.at(4.5 * (k % 9973) / 9973.0, (k % 101) / 100.0).theta;
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    printf("%.1f M interpolated lookups/s (checksum %.3f)\n", lookups / secs / 1e6, sum / lookups);
+    return 0;
+}
+
+void solve(double n) {
+    Polytrope p = integrate(n);
     printf("\nLane-Emden (n = %.1f)\n", n);
     printf("%-10s %-10s %-10s\n", "xi", "theta", "phi");
-    while (s.theta > 0 && xi < 20.0) {
-        if (fmod(xi, 0.5) < h) 
-        {
-            printf("%-10.4f %-10.4f %-10.4f\n", xi, s.theta, s.phi);
-        }
-        State k1 = deriv(xi, s, n);
-        State k2 = deriv(xi + h/2, {s.theta + h/2 * k1.theta, s.phi + h/2 * k1.phi}, n);
-        State k3 = deriv(xi + h/2, {s.theta + h/2 * k2.theta, s.phi + h/2 * k2.phi}, n);
-        State k4 = deriv(xi + h, {s.theta + h * k3.theta, s.phi + h * k3.phi}, n);
-
-        s.theta += (h/6.0) * (k1.theta + 2*k2.theta + 2*k3.theta + k4.theta);
-        s.phi += (h/6.0) * (k1.phi + 2*k2.phi + 2*k3.phi + k4.phi);
-        xi += h;
+    for (double xi = 0; xi < p.xi1; xi += 0.5) {
+        State s = xi == 0 ? State{1, 0} : p.at(xi);
+        printf("%-10.4f %-10.4f %-10.4f\n", xi, s.theta, s.phi);
     }
-    printf("Surface at xi_1 = %.4f\n", xi);
+    PolyConstants c = constantsOf(p);
+    printf("Surface at xi_1 = %.6f, -xi^2 theta' = %.6f, rho_c/rho_mean = %.4f (%zu steps)\n", p.xi1, c.omega, c.dn,
+           p.steps.size());
 }
-int main() {
+
+int main(int argc, char** argv) {
+    string table, check;
+    double nMin = 0, nMax = 4.95, dn = 0.01, tol = 1e-12;
+    uint32_t points = 1024;
+    int threads = max(1u, thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        size_t eq = a.find('=');
+        string key = a.substr(0, eq), val = eq == string::npos ? "" : a.substr(eq + 1);
+        if (key == "--table") table = val;
+        else if (key == "--check") check = val;
+        else if (key == "--nmin") nMin = stod(val);
+        else if (key == "--nmax") nMax = stod(val);
+        else if (key == "--dn") dn = stod(val);
+        else if (key == "--points") points = max(2, stoi(val));
+        else if (key == "--tol") tol = stod(val);
+        else if (key == "--threads") threads = max(1, stoi(val));
+        else {
+            fprintf(stderr, "unknown option %s\n"
+                    "usage: %s [--table=FILE [--nmin=N] [--nmax=N] [--dn=D] [--points=P] [--tol=T] [--threads=T]]\n"
+                    "          [--check=FILE]\n", a.c_str(), argv[0]);
+            return 1;
+        }
+    }
+    if (!table.empty()) {
+        if (!(nMin >= 0 && nMin <= nMax && nMax < 5 && dn > 0)) {
+            fprintf(stderr, "need 0 <= nmin <= nmax < 5 and dn > 0\n");
+            return 1;
+        }
+        // The lookup stencil needs 4 indices; the grid is never padded past nmax.
+        size_t count = (size_t)floor((nMax - nMin) / dn + 1e-9) + 1;
+        if (count < 4) {
+            fprintf(stderr, "need at least 4 indices: nmax - nmin >= 3 dn\n");
+            return 1;
+        }
+        return buildTable(nMin, dn, count, points, tol, threads, table);
+    }
+    if (!check.empty()) return checkTable(check);
+
     solve(0.0);
     solve(1.0);
     solve(1.5);
@@ -0,0 +1,340 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <ctime>
+using namespace std;
+
+const double TSun = 5772;
+
+// Counter-based random numbers: draw `stream` of star `index` is a pure
+// function of (seed, index, stream), so any thread can generate any star and
+// the population does not depend on how the work is split.
+inline double uniform01(uint64_t seed, uint64_t index, uint32_t stream) {
+    uint64_t z = seed ^ (index * 4 + stream + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return ((z >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+// Kroupa (2001) IMF, dN/dm ~ m^-alpha with alpha = 0.3, 1.3, 2.3 below 0.08,
+// between 0.08 and 0.5, and above 0.5 Msun, sampled by inverting the
+// piecewise power-law CDF.
+class KroupaIMF {
+public:
+    KroupaIMF(double mMin, double mMax) {
+        static const double edges[4] = {0.01, 0.08, 0.5, 1e9}, alpha[3] = {0.3, 1.3, 2.3};
+        double k = 1, total = 0;
+        for (int s = 0; s < 3; s++) {
+            if (s > 0) k *= pow(edges[s], alpha[s] - alpha[s - 1]);     // continuity at the break
+            Seg g = {max(mMin, edges[s]), min(mMax, edges[s + 1]), alpha[s], k, 0};
+            if (g.lo >= g.hi) continue;
+            g.weight = k * integral(g.lo, g.hi, g.alpha);
+            total += g.weight;
+            segs.push_back(g);
+        }
+        double c = 0;
+        for (auto& g : segs) g.weight = (c += g.weight / total);
+    }
+
+    double sample(double u) const {
+        double c0 = 0;
+        for (const auto& g : segs) {
+            if (u <= g.weight || &g == &segs.back()) {
+                double f = min(1.0, (u - c0) / (g.weight - c0));
+                double p = 1 - g.alpha;
+                double a = pow(g.lo, p), b = pow(g.hi, p);
+                return pow(a + f * (b - a), 1 / p);
+            }
+            c0 = g.weight;
+        }
+        return segs.back().hi;
+    }
+
+private:
+    struct Seg {
+        double lo, hi, alpha, k, weight;    // weight becomes the cumulative fraction
+    };
+    static double integral(double a, double b, double alpha) {
+        double p = 1 - alpha;
+        return (pow(b, p) - pow(a, p)) / p;
+    }
+    vector<Seg> segs;
+};
+
+enum Phase : uint8_t { MainSequence, Subgiant, Giant, CoreHe, AGB, WhiteDwarf, Remnant, NumPhases };
+
+const char* phaseName(Phase p) {
+    static const char* names[NumPhases] = {"main sequence", "subgiant", "giant", "core He", "AGB",
+                                           "white dwarf", "NS/BH"};
+    return names[p];
+}
+
+// Equivalent evolutionary points shared by every track; interpolation between
+// two masses is done at equal fractional progress between the same EEPs.
+enum EEP { ZAMS, MidMS, TAMS, BaseGiant, TipGiant, StartHe, EndHe, EndAGB, NumEEPs };
+
+// Phase of a star between EEP j and j + 1.
+const Phase eepPhase[NumEEPs - 1] = {MainSequence, MainSequence, Subgiant, Giant, Giant, CoreHe, AGB};
+
+struct TrackPoint {
+    double logAge;          // ln(age / Gyr); unused at ZAMS
+    float logL, logT;
+};
+
+// Mass-dependent tracks on a log-mass grid. The points come from analytic
+// fits (mass-luminosity and mass-radius relations, t_MS ~ M^-2.5, giant and
+// core-He luminosities for low, intermediate and high masses), standing in
+// for a grid of stellar models: anything that fills the EEP table works.
+class TrackGrid {
+public:
+    static const int Masses = 256;
+    static constexpr double LogMMin = -1.1, LogMMax = 2.1;     // 0.08 .. 126 Msun
+
+    TrackGrid() {
+        for (int i = 0; i < Masses; i++) build(pow(10.0, LogMMin + (LogMMax - LogMMin) * i / (Masses - 1)), tracks[i]);
+    }
+
+    // log10 L, log10 Teff and phase of a star of mass m (Msun) and age t (Gyr).
+    void evolve(double m, double t, float& logL, float& logT, Phase& phase) const {
+        double u = (log10(m) - LogMMin) * ((Masses - 1) / (LogMMax - LogMMin));
+        u = min((double)Masses - 1.001, max(0.0, u));
+        int i = (int)u;
+        double w = u - i;
+        const TrackPoint* a = tracks[i];
+        const TrackPoint* b = tracks[i + 1];
+
+        // EEP ages are interpolated in log age; only the bracketing pair is
+        // converted back.
+        double lt = log(max(t, 1e-12)), eep[NumEEPs];
+        for (int j = 1; j < NumEEPs; j++) eep[j] = a[j].logAge + (b[j].logAge - a[j].logAge) * w;
+        if (lt >= eep[EndAGB]) {
+            remnant(m, t - exp(eep[EndAGB]), logL, logT, phase);
+            return;
+        }
+        int j = 0;
+        while (lt >= eep[j + 1]) j++;
+        double t0 = j ? exp(eep[j]) : 0, t1 = exp(eep[j + 1]);
+        double f = (t - t0) / (t1 - t0);
+        float la = a[j].logL + (a[j + 1].logL - a[j].logL) * f, lb = b[j].logL + (b[j + 1].logL - b[j].logL) * f;
+        float ta = a[j].logT + (a[j + 1].logT - a[j].logT) * f, tb = b[j].logT + (b[j + 1].logT - b[j].logT) * f;
+        logL = la + (lb - la) * w;
+        logT = ta + (tb - ta) * w;
+        phase = eepPhase[j];
+    }
+
+private:
+    TrackPoint tracks[Masses][NumEEPs];
+
+    static double zamsLum(double m) {
+        if (m < 0.43) return 0.23 * pow(m, 2.3);
+        if (m < 2) return pow(m, 4);
+        if (m < 55) return 1.4 * pow(m, 3.5);
+        return 32000 * m;
+    }
+    static double zamsRadius(double m) { return m < 1 ? pow(m, 0.8) : pow(m, 0.57); }
+    static double msLifetime(double m) { return m <= 10 ? 10 * pow(m, -2.5) : 10 * pow(10.0, -2.5) * pow(m / 10, -0.9); }
+    static float logTeff(double lum, double radius) { return (float)log10(TSun * pow(lum / (radius * radius), 0.25)); }
+
+    static void build(double m, TrackPoint* p) {
+        double lz = zamsLum(m), rz = zamsRadius(m), tms = msLifetime(m);
+        double grow = m < 0.5 ? 1.2 : 2.0, swell = m < 0.5 ? 1.1 : 1.7;
+        double lt = lz * grow, rt = rz * swell;
+        auto set = [&](EEP e, double age, double lum, float logT) { p[e] = {log(max(age, 1e-12)), (float)log10(lum), logT}; };
+        set(ZAMS, 0, lz, logTeff(lz, rz));
+        set(MidMS, 0.5 * tms, lz * sqrt(grow), logTeff(lz * sqrt(grow), rz * sqrt(swell)));
+        set(TAMS, tms, lt, logTeff(lt, rt));
+        if (m < 2.2) {
+            // Subgiant, red giant branch to the He flash, red clump, AGB.
+            set(BaseGiant, tms * 1.08, lt * 1.1, (float)log10(5000.0));
+            set(TipGiant, tms * 1.18, 2500, (float)log10(3800.0));
+            set(StartHe, tms * 1.18 + 1e-4, 50, (float)log10(4800.0));
+            set(EndHe, tms * 1.18 + 0.1, 80, (float)log10(4600.0));
+            set(EndAGB, tms * 1.18 + 0.115, 5000, (float)log10(3200.0));
+        } else if (m < 8) {
+            // Fast Hertzsprung-gap crossing, blue loop during core He burning.
+            set(BaseGiant, tms * 1.02, lt, (float)log10(5200.0));
+            set(TipGiant, tms * 1.04, lt * 1.6, (float)log10(4200.0));
+            set(StartHe, tms * 1.05, lt * 1.3, (float)log10(4600.0));
+            set(EndHe, tms * 1.25, lt * 1.6, (float)log10(5800.0));
+            set(EndAGB, tms * 1.3, lt * 4, (float)log10(3300.0));
+        } else {
+            // Crossing to a red supergiant, core He and the last stages there.
+            set(BaseGiant, tms * 1.01, lt * 1.1, (float)log10(min(12000.0, pow(10.0, p[TAMS].logT))));
+            set(TipGiant, tms * 1.02, lt * 1.2, (float)log10(3700.0));
+            set(StartHe, tms * 1.03, lt * 1.25, (float)log10(3650.0));
+            set(EndHe, tms * 1.12, lt * 1.4, (float)log10(3600.0));
+            set(EndAGB, tms * 1.13, lt * 1.5, (float)log10(3500.0));
+        }
+    }
+
+    // After the last EEP: white dwarf with mass from the Kalirai et al. (2008)
+    // initial-final relation and Mestel-like cooling, or a neutron star /
+    // black hole (no luminosity) above 8 Msun.
+    static void remnant(double m, double tCool, float& logL, float& logT, Phase& phase) {
+        if (m >= 8) {
+            logL = logT = 0;
+            phase = Remnant;
+            return;
+        }
+        double mwd = 0.109 * m + 0.394;
+        double lum = min(100.0, 0.01 * (mwd / 0.6) * pow(max(tCool, 1e-6) / 0.1, -1.4));
+        double radius = 0.0127 * pow(mwd, -1.0 / 3);
+        logL = (float)log10(lum);
+        logT = logTeff(lum, radius);
+        phase = WhiteDwarf;
+    }
+};
+
+// Structure-of-arrays population. Ages in Gyr, masses in Msun (initial).
+struct Population {
+    size_t n = 0;
+    vector<float> mass, age, logL, logT;
+    vector<uint8_t> phase;
+
+    void resize(size_t count) {
+        n = count;
+        for (auto* v : {&mass, &age, &logL, &logT}) v->resize(n);
+        phase.resize(n);
+    }
+};
+
+struct SynthParams {
+    uint64_t seed = 1;
+    double mMin = 0.08, mMax = 100;
+    double tMax = 10;           // constant star formation over [0, tMax] Gyr
+};
+
+// Fills stars [k0, k1).
+void synthesize(const SynthParams& par, const KroupaIMF& imf, const TrackGrid& tracks, Population& pop, size_t k0,
+                size_t k1) {
+    for (size_t k = k0; k < k1; k++) {
+        double m = imf.sample(uniform01(par.seed, k, 0));
+        double t = par.tMax * uniform01(par.seed, k, 1);
+        Phase ph;
+        tracks.evolve(m, t, pop.logL[k], pop.logT[k], ph);
+        pop.mass[k] = (float)m;
+        pop.age[k] = (float)t;
+        pop.phase[k] = ph;
+    }
+}
+
+// Catalog file: header, then the columns one after another (mass, age, logL,
+// logTeff as float32, phase as uint8).
+struct CatalogHeader {
+    char magic[8];          // "STARPOP1"
+    uint32_t version;       // 1
+    uint32_t columns;       // 5
+    uint64_t count;
+    uint64_t seed;
+    double mMin, mMax, tMax;
+};
+
+bool saveCatalog(const string& path, const Population& pop, const SynthParams& par) {
+    string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) {
+        fprintf(stderr, "cannot write %s\n", tmp.c_str());
+        return false;
+    }
+    CatalogHeader h = {};
+    memcpy(h.magic, "STARPOP1", 8);
+    h.version = 1;
+    h.columns = 5;
+    h.count = pop.n;
+    h.seed = par.seed;
+    h.mMin = par.mMin;
+    h.mMax = par.mMax;
+    h.tMax = par.tMax;
+    bool ok = fwrite(&h, sizeof h, 1, f) == 1;
+    for (auto* c : {&pop.mass, &pop.age, &pop.logL, &pop.logT}) ok = ok && fwrite(c->data(), 4, pop.n, f) == pop.n;
+    ok = ok && fwrite(pop.phase.data(), 1, pop.n, f) == pop.n;
+    ok = fclose(f) == 0 && ok;
+    return ok && rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+int run(size_t count, const SynthParams& par, int threads, const string& out) {
+    auto t0 = chrono::steady_clock::now();
+    KroupaIMF imf(par.mMin, par.mMax);
+    TrackGrid tracks;
+    double setup = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    Population pop;
+    pop.resize(count);
+    const size_t chunk = 1 << 16;
+    atomic<size_t> next{0};
+    vector<double> busy(threads);
+    t0 = chrono::steady_clock::now();
+    auto work = [&](int th) {
+        for (size_t k0; (k0 = next.fetch_add(chunk)) < count;) synthesize(par, imf, tracks, pop, k0, min(count, k0 + chunk));
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        busy[th] = ts.tv_sec + ts.tv_nsec * 1e-9;
+    };
+    vector<thread> pool;
+    for (int th = 1; th < threads; th++) pool.emplace_back(work, th);
+    work(0);
+    for (auto& t : pool) t.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count(), cpu = 0;
+    for (double b : busy) cpu += b;
+
+    size_t counts[NumPhases] = {};
+    double massSum = 0;
+    for (size_t k = 0; k < pop.n; k++) {
+        counts[pop.phase[k]]++;
+        massSum += pop.mass[k];
+    }
+    printf("%zu stars (Kroupa %.2f-%.0f Msun, constant SFR over %.1f Gyr, seed %llu)\n", count, par.mMin, par.mMax,
+           par.tMax, (unsigned long long)par.seed);
+    printf("tracks in %.3f s; %d threads: %.3f s, %.1f M stars/s, %.1f M stars/s per core\n", setup, threads, secs,
+           count / secs / 1e6, count / cpu / 1e6);
+    printf("mean mass %.3f Msun\n", massSum / max<size_t>(1, count));
+    for (int p = 0; p < NumPhases; p++)
+        printf("  %-14s %10zu  %6.3f%%\n", phaseName((Phase)p), counts[p], 100.0 * counts[p] / max<size_t>(1, count));
+    if (!out.empty()) {
+        if (!saveCatalog(out, pop, par)) {
+            fprintf(stderr, "cannot write %s\n", out.c_str());
+            return 1;
+        }
+        printf("wrote %s\n", out.c_str());
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    size_t count = 1000000;
+    SynthParams par;
+    int threads = max(1u, thread::hardware_concurrency());
+    string out;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        size_t eq = a.find('=');
+        string key = a.substr(0, eq), val = eq == string::npos ? "" : a.substr(eq + 1);
+        if (key == "--stars") count = stoull(val);
+        else if (key == "--seed") par.seed = stoull(val);
+        else if (key == "--mmin") par.mMin = stod(val);
+        else if (key == "--mmax") par.mMax = stod(val);
+        else if (key == "--tmax") par.tMax = stod(val);
+        else if (key == "--threads") threads = max(1, stoi(val));
+        else if (key == "--out") out = val;
+        else {
+            fprintf(stderr, "unknown option %s\n"
+                    "usage: %s [--stars=N] [--seed=S] [--mmin=M] [--mmax=M] [--tmax=GYR] [--threads=T] [--out=FILE]\n",
+                    a.c_str(), argv[0]);
+            return 1;
+        }
+    }
+    if (par.mMin < 0.08 || par.mMax > 120 || par.mMin >= par.mMax) {
+        fprintf(stderr, "masses must satisfy 0.08 <= mmin < mmax <= 120\n");
+        return 1;
+    }
+    return run(count, par, threads, out);
+}